@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "storage_mgr.h"
+#include "dberror.h"
+
+/* storage manager benchmark: every pattern writes and then reads the file
+ * through readBlock/writeBlock, one handle per thread, and reports
+ * throughput, IOPS and per-call latency percentiles */
+
+#define BENCH_FILE "bench_pagefile.bin"
+
+typedef enum Pattern
+{
+    PATTERN_SEQ,
+    PATTERN_RANDOM,
+    PATTERN_STRIDED
+} Pattern;
+
+static const char *patternNames[] = {"seq", "random", "strided"};
+
+typedef struct BenchConfig
+{
+    char *fileName;
+    PageNumber numPages; // file size
+    int pageSize;
+    int numThreads;
+    long long opsPerThread; // 0 = every thread covers its share of the file once
+    int stride; // pages between accesses of the strided pattern
+    int sync; // fdatasync the file at the end of the write phase, inside the timing
+    unsigned seed;
+} BenchConfig;
+
+typedef struct BenchThread
+{
+    BenchConfig *config;
+    Pattern pattern;
+    int isWrite;
+    int id;
+    long long numOps;
+    long long *latencies; // ns per call
+    long long readCalls;
+    long long writeCalls;
+    RC result;
+    pthread_t thread;
+} BenchThread;
+
+static long long nowNanos(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static PageNumber nextPage(BenchThread *t, long long i, unsigned *seed)
+{
+    BenchConfig *c = t->config;
+    PageNumber share = c->numPages / c->numThreads;
+    PageNumber first = share * t->id;
+
+    switch (t->pattern)
+    {
+    case PATTERN_SEQ:
+        return first + i % share;
+    case PATTERN_RANDOM:
+        return (((PageNumber)rand_r(seed) << 31) ^ rand_r(seed)) % c->numPages;
+    default:
+        // walks the thread's share with the stride, shifting by one page per pass
+        return first + (i * c->stride + i * c->stride / share) % share;
+    }
+}
+
+static void *benchWorker(void *arg)
+{
+    BenchThread *t = arg;
+    BenchConfig *c = t->config;
+    SM_FileHandle fh;
+    SM_FileStats stats;
+    SM_PageHandle page;
+    unsigned seed = c->seed + t->id;
+
+    t->result = RC_MEMORY_ALLOCATION_FAILED;
+    if (posix_memalign((void **)&page, SM_IO_ALIGNMENT, c->pageSize) != 0)
+        return NULL;
+    memset(page, 'a' + t->id % 26, c->pageSize);
+
+    t->result = openPageFile(c->fileName, &fh);
+    if (t->result != RC_OK)
+    {
+        free(page);
+        return NULL;
+    }
+
+    for (long long i = 0; i < t->numOps && t->result == RC_OK; i++)
+    {
+        PageNumber pageNum = nextPage(t, i, &seed);
+        long long start = nowNanos();
+
+        t->result = t->isWrite ? writeBlock(pageNum, &fh, page) : readBlock(pageNum, &fh, page);
+        t->latencies[i] = nowNanos() - start;
+    }
+
+    if (t->result == RC_OK && t->isWrite && c->sync)
+        t->result = syncBlocks(0, (int)fh.totalNumPages, &fh);
+
+    getFileStats(&fh, &stats);
+    t->readCalls = stats.numReadCalls;
+    t->writeCalls = stats.numWriteCalls;
+
+    closePageFile(&fh);
+    free(page);
+    return NULL;
+}
+
+static int compareLatency(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+static RC runPhase(BenchConfig *c, Pattern pattern, int isWrite)
+{
+    BenchThread *threads = calloc(c->numThreads, sizeof(BenchThread));
+    long long opsPerThread = c->opsPerThread ? c->opsPerThread : c->numPages / c->numThreads;
+    long long totalOps = opsPerThread * c->numThreads;
+    long long *latencies = malloc(totalOps * sizeof(long long));
+    long long readCalls = 0, writeCalls = 0;
+    RC result = RC_OK;
+
+    if (threads == NULL || latencies == NULL)
+    {
+        free(threads);
+        free(latencies);
+        return RC_MEMORY_ALLOCATION_FAILED;
+    }
+
+    long long start = nowNanos();
+    for (int i = 0; i < c->numThreads; i++)
+    {
+        threads[i].config = c;
+        threads[i].pattern = pattern;
+        threads[i].isWrite = isWrite;
+        threads[i].id = i;
+        threads[i].numOps = opsPerThread;
+        threads[i].latencies = latencies + i * opsPerThread;
+        pthread_create(&threads[i].thread, NULL, benchWorker, &threads[i]);
+    }
+
+    for (int i = 0; i < c->numThreads; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+        if (threads[i].result != RC_OK)
+            result = threads[i].result;
+        readCalls += threads[i].readCalls;
+        writeCalls += threads[i].writeCalls;
+    }
+    double seconds = (nowNanos() - start) / 1e9;
+
+    if (result == RC_OK)
+    {
+        qsort(latencies, totalOps, sizeof(long long), compareLatency);
+        printf("%-8s %-6s %7d %10lld %10.1f %10.0f %9.1f %9.1f %10lld\n",
+               patternNames[pattern], isWrite ? "write" : "read", c->numThreads, totalOps,
+               totalOps * (double)c->pageSize / seconds / (1024 * 1024), totalOps / seconds,
+               latencies[totalOps / 2] / 1000.0, latencies[totalOps * 99 / 100] / 1000.0,
+               isWrite ? writeCalls : readCalls);
+    }
+
+    free(threads);
+    free(latencies);
+    return result;
+}
+
+// the file is created up front so no pattern pays for growing it
+static RC prepareFile(BenchConfig *c)
+{
+    SM_FileHandle fh;
+    long long start = nowNanos();
+    RC result;
+
+    destroyPageFile(c->fileName);
+    if ((result = createPageFileSized(c->fileName, c->pageSize, 0)) != RC_OK ||
+        (result = openPageFile(c->fileName, &fh)) != RC_OK)
+        return result;
+
+    result = ensureCapacity(c->numPages, &fh);
+    closePageFile(&fh);
+
+    printf("create + ensureCapacity(%lld pages of %d bytes): %.1f ms\n", c->numPages, c->pageSize,
+           (nowNanos() - start) / 1e6);
+    return result;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-p seq|random|strided] [-n pages] [-z pageSize] [-t threads]\n"
+           "          [-o opsPerThread] [-s stride] [-r seed] [-f] [-k] [-F file]\n"
+           "  -f  fdatasync at the end of every write phase\n"
+           "  -k  keep the benchmark file\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config = {.fileName = BENCH_FILE, .numPages = 16384, .pageSize = PAGE_SIZE,
+                          .numThreads = 1, .stride = 17, .seed = 42};
+    int patterns = -1, keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "p:n:z:t:o:s:r:fkF:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            for (patterns = 0; patterns < 3 && strcmp(optarg, patternNames[patterns]) != 0; patterns++)
+                ;
+            if (patterns == 3)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'n':
+            config.numPages = atoll(optarg);
+            break;
+        case 'z':
+            config.pageSize = atoi(optarg);
+            break;
+        case 't':
+            config.numThreads = atoi(optarg);
+            break;
+        case 'o':
+            config.opsPerThread = atoll(optarg);
+            break;
+        case 's':
+            config.stride = atoi(optarg);
+            break;
+        case 'r':
+            config.seed = (unsigned)atoi(optarg);
+            break;
+        case 'f':
+            config.sync = 1;
+            break;
+        case 'k':
+            keep = 1;
+            break;
+        case 'F':
+            config.fileName = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (config.numThreads < 1 || config.stride < 1 || config.opsPerThread < 0 ||
+        config.numPages < config.numThreads)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    initStorageManager();
+
+    RC result = prepareFile(&config);
+
+    if (result == RC_OK)
+        printf("%-8s %-6s %7s %10s %10s %10s %9s %9s %10s\n",
+               "pattern", "op", "threads", "ops", "MB/s", "IOPS", "p50(us)", "p99(us)", "syscalls");
+
+    for (int p = 0; p < 3 && result == RC_OK; p++)
+    {
+        if (patterns >= 0 && p != patterns)
+            continue;
+
+        if ((result = runPhase(&config, (Pattern)p, 1)) == RC_OK)
+            result = runPhase(&config, (Pattern)p, 0);
+    }
+
+    if (result != RC_OK)
+        printError(result);
+
+    if (!keep)
+        destroyPageFile(config.fileName);
+
+    return result == RC_OK ? 0 : 1;
+}
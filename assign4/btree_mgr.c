@@ -9,6 +9,10 @@
 #include "dberror.h"
 
 #define MAX_KEYS 100
+
+// Open tablespace holding every index as a relation, NULL for one page file per index
+static SM_Tablespace *indexSpace = NULL;
+
 RC splitNode(Tree_Node *nodePointer, int scanPosition, Value key, Tree_Node *right, int reclist_size);
 
 // Function to evaluate the lexicographic order of two strings
@@ -228,18 +232,15 @@ Tree_Node *createNode()
 // Function : initIndexManager
 // Description : This function initializes the index manager for managing B+ trees, ensuring that all 
 //               necessary structures and global variables are properly set up for operation.
-// Inputs : void *mgmtData - Pointer to any management data that may be required for initialization.
+// Inputs : void *mgmtData - An open SM_Tablespace to keep the indexes in, or NULL for one page file each.
 // Returns : RC_OK on successful initialization, or an error code if initialization fails.
 RC initIndexManager(void *mgmtData)
 {
     // Initialize the return code to indicate success
     RC statusCode = RC_OK;
 
-    // Check if management data is provided, leaving room for future use
-    if (mgmtData != NULL)
-    {
-        // Reserved for potential handling of mgmtData
-    }
+    // Indexes are created, opened and deleted as relations of this tablespace if one is given
+    indexSpace = (SM_Tablespace *)mgmtData;
 
     // Reset treeRoot to NULL to start with a clean configuration
     if (treeRoot)
@@ -279,6 +280,9 @@ RC shutdownIndexManager()
         treeRoot = NULL;  // Reset pointer to NULL to prevent future access
     }
 
+    // The tablespace stays open, closing it is up to the caller
+    indexSpace = NULL;
+
     // Return the outcome of the shutdown process
     return statusCode;
 }
@@ -293,8 +297,8 @@ RC shutdownIndexManager()
 // Returns : RC_OK if the metadata is successfully written, or an error code if any operation fails.
 RC setupAndStoreMetadata(SM_FileHandle *fhandle, DataType keyType, int n)
 {
-    // Allocate memory for storing metadata
-    SM_PageHandle metadataBuffer = (SM_PageHandle)malloc(PAGE_SIZE);
+    // Allocate memory for storing metadata, one page of the index file's page size
+    SM_PageHandle metadataBuffer = (SM_PageHandle)calloc(1, getPageSize(fhandle));
     RC status = RC_OK; // Initialize status variable to track the result of operations
     int currentStep = 0; // Variable to control the progression through the steps
 
@@ -325,6 +329,22 @@ RC setupAndStoreMetadata(SM_FileHandle *fhandle, DataType keyType, int n)
     return RC_OK; // Return success if all operations completed without errors
 }
 
+// Function : nodePageSize
+// Description : Picks the smallest supported page size that holds one node of the tree,
+//               so wide trees get large pages (and stay shallow) while narrow ones keep PAGE_SIZE.
+// Inputs : int n - The fan-out, a node holds n keys and n + 1 pointers.
+// Returns : The page size in bytes, or 0 if a node does not fit the largest page size.
+int nodePageSize(int n)
+{
+    long nodeBytes = sizeof(int) + (long)n * sizeof(Value) + (long)(n + 1) * sizeof(RID);
+    int pageSize = PAGE_SIZE;
+
+    while (pageSize < nodeBytes && pageSize < SM_MAX_PAGE_SIZE)
+        pageSize *= 2;
+
+    return (pageSize >= nodeBytes) ? pageSize : 0;
+}
+
 // Author : Sanketkumar Patel
 // Function : createBtree
 // Description : This function creates a B-tree by generating a page file, opening it, 
@@ -339,21 +359,35 @@ RC createBtree(char *idxId, DataType keyType, int n)
 {
     RC result;               // Variable to hold the result of file-related operations
     SM_FileHandle file;      // File handle used to interact with the page file
+    int pageSize = nodePageSize(n); // Page size large enough for one node
+
+    if (pageSize == 0)
+    {
+        return RC_IM_N_TOO_LARGE; // A node of this fan-out does not fit any supported page size
+    }
 
-    // Step 1: Create a new page file for the B-tree
-    result = createPageFile(idxId);
+    // Step 1: Create a new page file (or relation) for the B-tree
+    result = (indexSpace != NULL) ? createRelation(indexSpace, idxId) : createPageFileSized(idxId, pageSize, 0);
     if (result != RC_OK)
     {
         return result; // If the file creation fails, return the corresponding error code
     }
 
     // Step 2: Open the newly created page file for further operations
-    result = openPageFile(idxId, &file);
+    result = (indexSpace != NULL) ? openRelation(indexSpace, idxId, &file) : openPageFile(idxId, &file);
     if (result != RC_OK)
     {
         return result; // If opening the file fails, return the error code
     }
 
+    // A relation has the tablespace's page size, which must still hold a node
+    if (indexSpace != NULL && getPageSize(&file) < pageSize)
+    {
+        closePageFile(&file);
+        dropRelation(indexSpace, idxId);
+        return RC_IM_N_TOO_LARGE;
+    }
+
     // Step 3: Initialize the metadata and write it to the page file
     result = setupAndStoreMetadata(&file, keyType, n);
     if (result != RC_OK)
@@ -392,8 +426,9 @@ RC openBtree(BTreeHandle **tree, char *idxId) {
     int pageCount = 10; // Define the buffer pool size (number of pages)
     ReplacementStrategy strategy = RS_CLOCK; // Choose the replacement strategy for page eviction
 
-    // Initialize the buffer pool with the provided parameters
-    statusCode = initBufferPool(bufferPool, fileName, pageCount, strategy, NULL);
+    // Initialize the buffer pool with the provided parameters, on the index's relation if it has one
+    BM_PoolParams poolParams = {.space = indexSpace};
+    statusCode = initBufferPoolWithParams(bufferPool, fileName, pageCount, strategy, NULL, &poolParams);
     if (statusCode != RC_OK) {
         free(*tree); // Free the allocated memory if initialization fails
         *tree = NULL;
@@ -525,8 +560,9 @@ RC deleteBtree(char *indexFileName)
         return RC_FILE_NOT_FOUND; // Error code indicating the file name is missing
     }
 
-    // Attempt to delete the page file and handle potential failure
-    if (destroyPageFile(indexFileName) != RC_OK) {
+    // Attempt to delete the page file (or relation) and handle potential failure
+    RC result = (indexSpace != NULL) ? dropRelation(indexSpace, indexFileName) : destroyPageFile(indexFileName);
+    if (result != RC_OK) {
         return RC_FILE_DELETION_FAILED; // Return error code if file deletion fails
     }
 
@@ -1,32 +1,144 @@
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
+#include "wal_mgr.h"
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
+
+// sequential pins recycle at most this many frames, and at most an eighth of the pool
+#define BM_RING_FRAMES 16
+// the page table is split into 1 << BM_STRIPE_BITS stripes with a latch each
+#define BM_STRIPE_BITS 6
+#define BM_STRIPES (1 << BM_STRIPE_BITS)
 typedef struct BMFrame{
-    int currpage; //the corresponding page in the file
+    PageNumber currpage; //the corresponding page in the file, first so the page table can point at it
     struct BMFrame *next;
-    char data[PAGE_SIZE];
+    char *data; // pageSize bytes, SM_IO_ALIGNMENT aligned so direct I/O needs no bounce copy
     struct BMFrame *prev;
     bool isdirty;
     bool refbit; //true=1 false=0 for clock
-    int fixCount;
+    int fixCount; // changed with atomic operations, raised from 0 only under the page's stripe latch
+    pthread_rwlock_t latch; // page latch: shared to read the data, exclusive to change or load it
+    int loading; // set while a miss reads the page, hits then wait for the latch
+    int prefetched; // read by prefetchPages and not pinned since, atomic
+    int ringSlot; // position in the sequential ring, -1 = a shared frame, atomic
+    LSN pageLSN; // newest logged change, the log must be durable up to here before the frame is written
+    long long *history; // LRU-K: times of the last K uncorrelated references, newest first, 0 = none
+    long long lastRef; // LRU-K: time of the newest reference, correlated or not
+    struct LFUBucket *bucket; // LFU: bucket of the frame's reference count
+    struct BMFrame *listPrev; // LFU bucket or ARC list neighbours, oldest first
+    struct BMFrame *listNext;
+    struct ARCList *arcList; // ARC: T1, T2 or the free list
     
 } BMFrame;
 typedef struct statlist{
     BMFrame *fpt; //BMFrame pt
     struct statlist *next;
 }statlist;
+typedef struct ARCList{
+    BMFrame *first; // least recently used
+    BMFrame *last;
+    int length;
+}ARCList;
+typedef struct ARCGhost{
+    PageNumber page; // first so the ghost table can point at it
+    struct ARCGhost *prev;
+    struct ARCGhost *next;
+    struct ARCGhostList *list; // B1, B2 or the spare list
+}ARCGhost;
+typedef struct ARCGhostList{
+    ARCGhost *first; // least recently evicted
+    ARCGhost *last;
+    int length;
+}ARCGhostList;
+typedef struct PageTable{
+    PageNumber **slots; // open addressing with linear probing, each entry points at the key of its element, NULL = empty slot
+    int mask; // slots has mask + 1 entries, doubled to stay at least twice the elements it holds
+    int count;
+}PageTable;
+typedef struct PageStripe{
+    pthread_mutex_t latch; // guards the table and fixCount rising from 0 for the frames in it
+    PageTable table;
+} __attribute__((aligned(64))) PageStripe;
 typedef struct BufferClass{ //use as a class
     BMFrame *head;
     BMFrame *tail;
-    int numWrite; //for writeIO
+    int numWrite; //for writeIO, atomic
     void *startData;
     int numFrames; // number of frames in the BMFrame list
-    int numRead; //for readIO  
+    int pageSize; // page size of the pool's file, every frame holds this many bytes
+    SM_FileHandle fHandle; // the pool's page file, open from initBufferPool to shutdownBufferPool
+    WAL_Log *log; // write-ahead log set by setPoolLog, NULL = frames are written unlogged
+    bool unsynced; // pages were written since the last forceFlushPool applied the durability policy
+    int numRead; //for readIO, atomic
+    pthread_rwlock_t fileLock; // shared for I/O inside the file, exclusive while it grows, see lockFile
+    bool compressed; // the file is compressed, its I/O always takes fileLock exclusively
+    pthread_mutex_t stratLock; // replacement state: lists, buckets, histories, ghosts and the clock hand
+    int numEvictWrite; // dirty victims written by pinPage, atomic
+    pthread_t writer; // background writer, running while writerRunning
+    bool writerRunning;
+    bool writerStop; // tells the writer to end
+    BM_WriterParams writerParams;
+    pthread_mutex_t writerLock; // guards the writer fields
+    pthread_cond_t writerWake; // ends the writer's pause early
+    pthread_t prefetcher; // reads the pages queued by prefetchPages, started by the first call
+    bool prefetcherRunning;
+    bool prefetchStop; // tells the prefetcher to end
+    struct PrefetchRequest *prefetchQueue; // ring of numFrames requested pages, further requests are dropped
+    int prefetchFirst;
+    int prefetchCount;
+    pthread_mutex_t prefetchLock; // guards the prefetcher fields and the queue
+    pthread_cond_t prefetchWake; // a page was queued or the prefetcher has to end
+    int numPrefetchRead; // pages read by the prefetcher, atomic
+    int numPrefetchUnused; // prefetched pages evicted before they were pinned, atomic
+    BMFrame **ring; // frames recycled by sequential misses, NULL = slot not filled yet
+    int ringSize;
+    int ringNext; // slot the next sequential miss recycles, the ring is under stratLock
     
     BMFrame *pointer; //special purposes;init as bfhead;clock used
     statlist *stathead; //statistics functions have to follow true sequence -.-|
+    PageStripe stripes[BM_STRIPES]; // currpage -> frame, the stripe is picked by the top bits of the page hash
+    BM_LRUKParams lruk; // RS_LRU_K settings taken from stratData
+    long long refTime; // LRU-K clock, advanced by every pinPage
+    struct LRUKGhost *ghosts; // LRU-K retained histories of evicted pages, numFrames entries
+    struct LRUKGhost **ghostHeap; // LRU-K: min-heap on lastRef in [0, numGhosts), free ghosts after it
+    int numGhosts;
+    long long *historyBlock; // backs the history arrays of the frames and the ghosts
+    BM_LFUParams lfu; // RS_LFU settings taken from stratData
+    long long lfuPins; // LFU pins since the pool was created, drives aging
+    struct LFUBucket *lfuLowest; // LFU buckets in ascending count order, every frame is in one
+    struct LFUBucket *lfuSpare; // unused buckets, chained through next
+    struct LFUBucket *lfuBlock; // numFrames buckets, enough for one per distinct count
+    ARCList arcT1; // ARC: pages referenced once since they were loaded
+    ARCList arcT2; // ARC: pages referenced at least twice
+    ARCList arcFree; // ARC: frames that never held a page
+    ARCGhostList arcB1; // ARC: pages recently evicted from T1
+    ARCGhostList arcB2; // ARC: pages recently evicted from T2
+    ARCGhostList arcSpare; // ARC: unused ghosts
+    ARCGhost *arcGhosts; // numFrames ghosts, B1 and B2 never hold more together
+    PageTable ghostTable; // ARC: page -> ghost in B1 or B2, LRU-K: page -> retained ghost
+    int arcTarget; // ARC: adaptive target size p of T1
 }BufferClass;
 
+typedef struct LFUBucket{
+    long long freq; // reference count shared by the bucket's frames
+    struct LFUBucket *prev;
+    struct LFUBucket *next;
+    BMFrame *first;
+    BMFrame *last;
+}LFUBucket;
+
+typedef struct PrefetchRequest{
+    PageNumber page;
+    BM_AccessPattern pattern;
+}PrefetchRequest;
+
+typedef struct LRUKGhost{
+    PageNumber page; // NO_PAGE = free entry, first so the ghost table can point at it
+    long long lastRef;
+    long long *history;
+    int heapSlot; // position in ghostHeap
+}LRUKGhost;
+
 
 
@@ -2,212 +2,1452 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include "storage_mgr.h"
 #include <math.h>
 #include "dberror.h"
 #include "buffer_initializer.h"
 
-RC lruk_buffer (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum)
+/* Page tables: resident pages (and ARC's ghost pages) are found by hashing
+   their number into an open addressing table instead of walking a list. An
+   entry points at the page number that starts a BMFrame or an ARCGhost. */
+
+static unsigned long long pageHash(PageNumber pageNum)
+{
+    // Fibonacci hashing, the high bits of the product are the well mixed ones
+    return (unsigned long long)pageNum * 11400714819323198485ull;
+}
+
+static int pageSlot(PageTable *table, PageNumber pageNum)
+{
+    return (int)(pageHash(pageNum) >> 32) & table->mask;
+}
+
+static RC tableCreate(PageTable *table, int entries)
+{
+    int size = 2;
+
+    while (size < 2 * entries)
+        size *= 2;
+
+    table->slots = calloc(size, sizeof(PageNumber *));
+    table->mask = size - 1;
+    table->count = 0;
+    return table->slots != NULL ? RC_OK : RC_MEMORY_ALLOCATION_FAILED;
+}
+
+static PageNumber *tableFind(PageTable *table, PageNumber pageNum)
+{
+    for (int slot = pageSlot(table, pageNum); table->slots[slot] != NULL; slot = (slot + 1) & table->mask)
+    {
+        if (*table->slots[slot] == pageNum)
+            return table->slots[slot];
+    }
+
+    return NULL;
+}
+
+static void tablePlace(PageTable *table, PageNumber *key)
+{
+    int slot = pageSlot(table, *key);
+
+    while (table->slots[slot] != NULL)
+        slot = (slot + 1) & table->mask;
+
+    table->slots[slot] = key;
+}
+
+static RC tableInsert(PageTable *table, PageNumber *key)
 {
+    // a stripe may get more than its share of the pool, so tables double at half load
+    if (2 * (table->count + 1) > table->mask + 1)
+    {
+        PageTable grown;
+
+        if (tableCreate(&grown, table->mask + 1) != RC_OK)
+            return RC_MEMORY_ALLOCATION_FAILED;
+        for (int slot = 0; slot <= table->mask; slot++)
+        {
+            if (table->slots[slot] != NULL)
+                tablePlace(&grown, table->slots[slot]);
+        }
+
+        free(table->slots);
+        table->slots = grown.slots;
+        table->mask = grown.mask;
+    }
+
+    tablePlace(table, key);
+    table->count++;
     return RC_OK;
 }
 
+// backward shift deletion: later entries of the probe run move up so no tombstones are needed
+static void tableRemove(PageTable *table, PageNumber *key)
+{
+    int hole = pageSlot(table, *key);
 
-BMFrame *checkPinned(BM_BufferPool *const bm, const PageNumber pageNum)
+    while (table->slots[hole] != key)
+    {
+        if (table->slots[hole] == NULL)
+            return;
+        hole = (hole + 1) & table->mask;
+    }
+
+    for (int slot = (hole + 1) & table->mask; table->slots[slot] != NULL; slot = (slot + 1) & table->mask)
+    {
+        int home = pageSlot(table, *table->slots[slot]);
+
+        // the entry may fill the hole only if its home slot is not inside (hole, slot]
+        if (((slot - home) & table->mask) >= ((slot - hole) & table->mask))
+        {
+            table->slots[hole] = table->slots[slot];
+            hole = slot;
+        }
+    }
+
+    table->slots[hole] = NULL;
+    table->count--;
+}
+
+static PageStripe *stripeOf(BufferClass *bf, PageNumber pageNum)
 {
-    BufferClass *bf = bm->mgmtData;
-    BMFrame *pt = bf->head;
- 
- 
-    while (true) {
-    if (pt->currpage == pageNum) {
-        pt->fixCount++;
-        return pt;
-    }
-    pt = pt->next;
-    if (pt == bf->head)
-        break;
+    return &bf->stripes[pageHash(pageNum) >> (64 - BM_STRIPE_BITS)];
 }
 
+// pins the frame holding pageNum, NULL if the page is not resident
+static BMFrame *pinResident(BufferClass *bf, PageNumber pageNum)
+{
+    PageStripe *stripe = stripeOf(bf, pageNum);
+
+    pthread_mutex_lock(&stripe->latch);
+    BMFrame *pt = (BMFrame *)tableFind(&stripe->table, pageNum);
+    if (pt != NULL)
+        __atomic_add_fetch(&pt->fixCount, 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_unlock(&stripe->latch);
 
-    return NULL;// == return false
+    return pt;
+}
+
+// the frame of a page the caller has pinned, which keeps it from being evicted meanwhile
+static BMFrame *findFrame(BufferClass *bf, PageNumber pageNum)
+{
+    PageStripe *stripe = stripeOf(bf, pageNum);
+
+    pthread_mutex_lock(&stripe->latch);
+    BMFrame *pt = (BMFrame *)tableFind(&stripe->table, pageNum);
+    pthread_mutex_unlock(&stripe->latch);
+
+    return pt;
+}
+
+static void releasePin(BMFrame *pt)
+{
+    __atomic_sub_fetch(&pt->fixCount, 1, __ATOMIC_ACQ_REL);
+}
+
+static int pinCount(BMFrame *pt)
+{
+    return __atomic_load_n(&pt->fixCount, __ATOMIC_ACQUIRE);
 }
 
 BufferClass* getBMmgmt(BM_BufferPool *bp){
     return bp->mgmtData;
 }
 
-int pinCurrentPage(PageNumber pageNum, BMFrame *pt, BM_BufferPool *const bm )
-/*pin page pointed by pt with pageNum-th page. If do not have, create one*/
+// write-ahead rule: the log records describing a frame reach disk before the frame does
+static RC logBeforeWrite(BufferClass *bf, LSN pageLSN)
 {
-    BufferClass *bf = getBMmgmt(bm);;
-    SM_FileHandle fHandle; 
-    
-    if(openPageFile(bm->pageFile, &fHandle) !=RC_OK) return RC_FILE_OPEN_FAILED;
-    
-    if(ensureCapacity(pageNum, &fHandle)!=RC_OK) return RC_INVALID_BUFFER_SIZE ;
+    if (bf->log == NULL || pageLSN <= 0)
+        return RC_OK;
 
-    
-    if (pt->isdirty!=false)
+    return flushLog(bf->log, pageLSN);
+}
+
+// reads and writes of pages inside a plain file run side by side under a shared
+// fileLock; growing the file, and any I/O on a compressed file (one decompression
+// buffer, a directory that moves), take it exclusively. Returns holding either.
+static void lockFile(BufferClass *bf, PageNumber pageNum)
+{
+    pthread_rwlock_rdlock(&bf->fileLock);
+    if (!bf->compressed && pageNum < bf->fHandle.totalNumPages)
+        return;
+
+    pthread_rwlock_unlock(&bf->fileLock);
+    pthread_rwlock_wrlock(&bf->fileLock);
+}
+
+static RC poolRead(BufferClass *bf, PageNumber pageNum, char *data)
+{
+    RC result = RC_OK;
+
+    lockFile(bf, pageNum);
+    // the handle tracks the file size, so the file is only grown for a page past its end
+    if (pageNum >= bf->fHandle.totalNumPages && ensureCapacity(pageNum + 1, &bf->fHandle) != RC_OK)
+        result = RC_INVALID_BUFFER_SIZE;
+    else if (readBlock(pageNum, &bf->fHandle, data) != RC_OK)
+        result = RC_FILE_NOT_FOUND;
+    pthread_rwlock_unlock(&bf->fileLock);
+
+    if (result == RC_OK)
+        __atomic_add_fetch(&bf->numRead, 1, __ATOMIC_RELAXED);
+    return result;
+}
+
+// writes a frame the caller keeps from changing, by a pin and a shared latch or by owning it
+static RC poolWrite(BufferClass *bf, BMFrame *pt)
+{
+    if (logBeforeWrite(bf, pt->pageLSN) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    lockFile(bf, pt->currpage);
+    RC result = writeBlock(pt->currpage, &bf->fHandle, pt->data);
+    pthread_rwlock_unlock(&bf->fileLock);
+
+    if (result != RC_OK)
+        return RC_WRITE_FAILED;
+
+    __atomic_store_n(&pt->isdirty, false, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bf->numWrite, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&bf->unsynced, true, __ATOMIC_RELAXED);
+    return RC_OK;
+}
+
+/* Replacement strategies: each has a victim function that picks an unpinned
+   frame, a load function for the bookkeeping once the victim is claimed for
+   a new page (the frame still names the victim page) and, where references
+   matter, a hit function. All of them run under stratLock. */
+
+static BMFrame *fifoVictim(BufferClass *bf)
+{
+    BMFrame *pt = bf->head;
+
+    do
     {
-       if (writeBlock(pt->currpage, &fHandle, pt->data) !=RC_OK) {return RC_WRITE_FAILED;}
-        
-        pt->isdirty = false;
-        bf->numWrite++;
+        if (pinCount(pt) == 0)
+            return pt;
+        pt = pt->next;
+    } while (pt != bf->head);
+
+    return NULL;
+}
+
+// the frame list is circular, so the head moves behind the tail by rotating
+static void moveToTail(BufferClass *bf, BMFrame *pt)
+{
+    if (pt == bf->tail)
+        return;
+
+    if (pt == bf->head)
+    {
+        bf->head = pt->next;
+        bf->tail = pt;
+        return;
     }
-    
-    if(readBlock(pageNum, &fHandle, pt->data)!=RC_OK) {return RC_FILE_NOT_FOUND;}
 
-    pt->fixCount = pt->fixCount+1;
-    bf->numRead = bf->numRead+1;
-    pt->currpage = pageNum;
-    
-    closePageFile(&fHandle);
-    
-    return 0;
-    
-    
+    pt->prev->next = pt->next;
+    pt->next->prev = pt->prev;
+    pt->prev = bf->tail;
+    pt->next = bf->head;
+    bf->tail->next = pt;
+    bf->head->prev = pt;
+    bf->tail = pt;
 }
 
-/* Pinning Functions*/
+// a frame left empty goes in front of the head, fifoVictim takes it next
+static void moveToHead(BufferClass *bf, BMFrame *pt)
+{
+    if (pt == bf->head)
+        return;
 
-void FIFOSetter(BMFrame *currentFrame ,  BufferClass *bufferManager){
-    BMFrame *prev = currentFrame->prev;
-    BMFrame *next = currentFrame->next;
-    BMFrame *tail = bufferManager->tail;
+    if (pt == bf->tail)
+    {
+        bf->head = pt;
+        bf->tail = pt->prev;
+        return;
+    }
 
-    prev->next = next;
-    next->prev = prev;
-    prev = tail;
+    pt->prev->next = pt->next;
+    pt->next->prev = pt->prev;
+    pt->prev = bf->tail;
+    pt->next = bf->head;
+    bf->tail->next = pt;
+    bf->head->prev = pt;
+    bf->head = pt;
+}
 
-    tail->next = currentFrame;
-    tail = currentFrame;
+static BMFrame *clockVictim(BufferClass *bf)
+{
+    BMFrame *pt = bf->pointer->next;
 
-    next = bufferManager->head;
-    bufferManager->head->prev = currentFrame;
+    do{
+        if (pinCount(pt) == 0)
+        {
+            if (!pt->refbit) //refbit = 0
+                return pt;
+            pt->refbit = false; //on the way set all bits to 0
+        }
+        pt = pt->next;
+    }
+    while (pt!=bf->pointer->next);
 
+    return NULL; //no avaliable BMFrame
 }
 
-RC fifo_buffer (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum, bool IsLRU)
+/* LRU-K: the victim is the unpinned page whose K-th newest reference is the
+   oldest, pages with fewer than K references go first in LRU order. Times
+   come from refTime, one tick per pinPage. */
+
+static void lrukReference(BufferClass *bf, BMFrame *pt)
 {
-   
-if (!IsLRU && checkPinned(bm, pageNum) ) {
-    return RC_OK; // Return success if the page is already pinned
+    long long now = ++bf->refTime;
+
+    // an uncorrelated reference shifts the history, moving older entries by the length
+    // of the correlated burst that just ended so the burst counts as one reference
+    if (now - pt->lastRef > bf->lruk.correlatedPeriod)
+    {
+        long long correlated = pt->lastRef - pt->history[0];
+
+        for (int i = bf->lruk.k - 1; i > 0; i--)
+            pt->history[i] = pt->history[i - 1] != 0 ? pt->history[i - 1] + correlated : 0;
+        pt->history[0] = now;
+    }
+
+    pt->lastRef = now;
 }
 
-// Load the page into memory using the FIFO (First-In-First-Out) replacement policy.
-BufferClass *bufferManager = getBMmgmt(bm);;
-// Load the current frame in the head
-BMFrame *currentFrame = bufferManager->head;
+static BMFrame *lrukVictim(BufferClass *bf)
+{
+    long long now = bf->refTime + 1; // the time the new page will be referenced at
+    int k = bf->lruk.k;
+    BMFrame *best = NULL;
+    bool bestEligible = false;
 
-// Find the first available BMFrame in the BufferClass pool.
-bool flag = false;
-while (currentFrame != bufferManager->head){
- if (currentFrame->fixCount == 0) {
-        flag = true;
-        break;
+    for (statlist *sptr = bf->stathead; sptr != NULL; sptr = sptr->next)
+    {
+        BMFrame *pt = sptr->fpt;
+
+        if (pinCount(pt) > 0)
+            continue;
+        if (pt->currpage == NO_PAGE)
+            return pt;
+
+        // pages still inside their correlated period are only taken when nothing else is unpinned
+        bool eligible = now - pt->lastRef > bf->lruk.correlatedPeriod;
+        if (best != NULL && bestEligible && !eligible)
+            continue;
+
+        if (best == NULL || eligible != bestEligible || pt->history[k - 1] < best->history[k - 1] ||
+            (pt->history[k - 1] == best->history[k - 1] && pt->history[0] < best->history[0]))
+        {
+            best = pt;
+            bestEligible = eligible;
+        }
     }
-    currentFrame = currentFrame->next;
+
+    return best;
+}
+
+/* Retained histories are found through ghostTable and kept in a min-heap
+   on lastRef, so the one referenced longest ago, which is also the first to
+   pass the retained information period, is replaced in O(log n). */
+
+static void ghostPlace(BufferClass *bf, LRUKGhost *ghost, int slot)
+{
+    bf->ghostHeap[slot] = ghost;
+    ghost->heapSlot = slot;
 }
-if (!flag) return RC_ERROR_PINNING_PAGE;
 
-if(pinCurrentPage(pageNum,currentFrame, bm) !=RC_OK) return RC_ERROR_PINNING_PAGE;
+// restores the heap order around slot after its ghost changed or was moved there
+static void ghostSift(BufferClass *bf, int slot)
+{
+    LRUKGhost *ghost = bf->ghostHeap[slot];
+
+    while (slot > 0 && bf->ghostHeap[(slot - 1) / 2]->lastRef > ghost->lastRef)
+    {
+        ghostPlace(bf, bf->ghostHeap[(slot - 1) / 2], slot);
+        slot = (slot - 1) / 2;
+    }
 
-page->data = currentFrame->data;
+    for (int child; (child = 2 * slot + 1) < bf->numGhosts; slot = child)
+    {
+        if (child + 1 < bf->numGhosts && bf->ghostHeap[child + 1]->lastRef < bf->ghostHeap[child]->lastRef)
+            child++;
+        if (bf->ghostHeap[child]->lastRef >= ghost->lastRef)
+            break;
+        ghostPlace(bf, bf->ghostHeap[child], slot);
+    }
 
-page->pageNum = pageNum;
+    ghostPlace(bf, ghost, slot);
+}
 
-// Update the BufferClass management lists to reflect the changes.
-if ( bufferManager->head == currentFrame) {
-    bufferManager->head = currentFrame->next;
+static LRUKGhost *findGhost(BufferClass *bf, PageNumber pageNum)
+{
+    return (LRUKGhost *)tableFind(&bf->ghostTable, pageNum);
 }
 
-FIFOSetter(currentFrame,bufferManager);
+// the ghost stops belonging to its page and moves behind the heap
+static void ghostRelease(BufferClass *bf, LRUKGhost *ghost)
+{
+    int slot = ghost->heapSlot;
+    LRUKGhost *last = bf->ghostHeap[--bf->numGhosts];
 
+    tableRemove(&bf->ghostTable, &ghost->page);
+    ghost->page = NO_PAGE;
+    ghostPlace(bf, ghost, bf->numGhosts);
 
+    if (last != ghost)
+    {
+        ghostPlace(bf, last, slot);
+        ghostSift(bf, slot);
+    }
+}
 
-return RC_OK; // Return success.
+// ghost already holds the evicted page's history; a free ghost joins the heap at its end
+static void lrukRetain(BufferClass *bf, PageNumber victim, BMFrame *pt, LRUKGhost *ghost)
+{
+    if (ghost->page == NO_PAGE)
+        bf->numGhosts++;
+    else
+        tableRemove(&bf->ghostTable, &ghost->page);
 
+    // the table holds numFrames entries at half load, inserts never have to grow it
+    ghost->page = victim;
+    ghost->lastRef = pt->lastRef;
+    tableInsert(&bf->ghostTable, &ghost->page);
+    ghostSift(bf, ghost->heapSlot);
 }
 
-void LRUSetter(BufferClass * bf, BMFrame *pt,BM_PageHandle *const page, const PageNumber pageNum){
+static void lrukLoad(BufferClass *bf, BMFrame *pt, PageNumber pageNum)
+{
+    long long now = ++bf->refTime;
+    LRUKGhost *ghost = findGhost(bf, pageNum);
+    bool retained = ghost != NULL && now - ghost->lastRef <= bf->lruk.retainedPeriod;
 
-        BMFrame *prev = pt->prev;
-        BMFrame *next = pt->next;
-        BMFrame *tail = bf->tail;
-        BMFrame *head = bf->head;
+    // the loaded page's ghost and the frame trade history arrays, the frame gets the
+    // retained history and the ghost goes on with the victim's
+    if (ghost != NULL)
+    {
+        long long *history = pt->history;
 
-    
-        prev->next = next;
-        next->prev = prev;
+        pt->history = ghost->history;
+        ghost->history = history;
+    }
+    else if (pt->currpage != NO_PAGE && bf->lruk.retainedPeriod > 0)
+    {
+        // the first free ghost, or the one referenced longest ago
+        ghost = bf->numGhosts < bf->numFrames ? bf->ghostHeap[bf->numGhosts] : bf->ghostHeap[0];
+        memcpy(ghost->history, pt->history, bf->lruk.k * sizeof(long long));
+    }
 
-        prev = tail;
-        tail->next = pt;
-        tail = pt;
-        
-        page->data = pt->data;
+    if (ghost != NULL && pt->currpage != NO_PAGE)
+        lrukRetain(bf, pt->currpage, pt, ghost);
+    else if (ghost != NULL)
+        ghostRelease(bf, ghost);
 
+    for (int i = bf->lruk.k - 1; i > 0; i--)
+        pt->history[i] = retained ? pt->history[i - 1] : 0;
+    pt->history[0] = now;
+    pt->lastRef = now;
+}
 
-        next = head;
+static int lrukReferences(BufferClass *bf, BMFrame *pt)
+{
+    int count = 0;
 
-        head->prev = pt;
-        
-        page->pageNum = pageNum;
+    for (int i = 0; i < bf->lruk.k; i++)
+        count += pt->history[i] != 0;
+
+    return count;
 }
 
-RC lru_buffer (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum)
-/*If not pinned then same as FIFO. If pinned then move to tail.*/
+// a load that left its frame empty gives the page's history back: to the frame
+// another miss loaded the page into if it knows more references than that one,
+// otherwise (the read failed) to a retained ghost. The empty frame starts over.
+static void lrukEmpty(BufferClass *bf, BMFrame *pt, PageNumber pageNum)
 {
-    BMFrame *ptr = checkPinned(bm,pageNum);
-    BufferClass *bf = getBMmgmt(bm);;
-    if (!ptr)
+    BMFrame *holder = pageNum != NO_PAGE ? findFrame(bf, pageNum) : NULL;
+
+    if (holder != NULL && lrukReferences(bf, pt) > lrukReferences(bf, holder))
+    {
+        long long *history = holder->history;
+
+        holder->history = pt->history;
+        pt->history = history;
+    }
+    else if (holder == NULL && pageNum != NO_PAGE && bf->lruk.retainedPeriod > 0 && findGhost(bf, pageNum) == NULL)
+    {
+        LRUKGhost *ghost = bf->numGhosts < bf->numFrames ? bf->ghostHeap[bf->numGhosts] : bf->ghostHeap[0];
+        long long *history = ghost->history;
+
+        ghost->history = pt->history;
+        pt->history = history;
+        lrukRetain(bf, pageNum, pt, ghost);
+    }
+
+    memset(pt->history, 0, bf->lruk.k * sizeof(long long));
+    pt->lastRef = 0;
+}
+
+static RC lrukInit(BufferClass *bf, BM_LRUKParams *params)
+{
+    BM_LRUKParams defaults = {2, 0, 4 * bf->numFrames};
+
+    bf->lruk = params != NULL ? *params : defaults;
+    if (bf->lruk.k < 1 || bf->lruk.correlatedPeriod < 0 || bf->lruk.retainedPeriod < 0)
+        return RC_INVALID_ARGUMENT;
+
+    // one block holds the K history entries of every frame and every retained page
+    bf->historyBlock = calloc(2 * (size_t)bf->numFrames * bf->lruk.k, sizeof(long long));
+    bf->ghosts = malloc(bf->numFrames * sizeof(LRUKGhost));
+    bf->ghostHeap = malloc(bf->numFrames * sizeof(LRUKGhost *));
+    if (bf->historyBlock == NULL || bf->ghosts == NULL || bf->ghostHeap == NULL ||
+        tableCreate(&bf->ghostTable, bf->numFrames) != RC_OK)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    long long *next = bf->historyBlock;
+    for (statlist *sptr = bf->stathead; sptr != NULL; sptr = sptr->next, next += bf->lruk.k)
     {
-        return fifo_buffer(bm, page, pageNum,true);
+        sptr->fpt->history = next;
+        sptr->fpt->lastRef = 0;
     }
+
+    bf->numGhosts = 0;
+    for (int i = 0; i < bf->numFrames; i++, next += bf->lruk.k)
+    {
+        bf->ghosts[i].page = NO_PAGE;
+        bf->ghosts[i].lastRef = 0;
+        bf->ghosts[i].history = next;
+        ghostPlace(bf, &bf->ghosts[i], i);
+    }
+
+    return RC_OK;
+}
+
+
+/* LFU: frames sit in buckets of equal reference count kept in ascending
+   order, so a reference moves a frame to the neighbouring bucket and the
+   victim is the oldest unpinned frame of the lowest bucket. Only pinned
+   frames at the front of the low buckets are ever skipped. */
+
+// the bucket for freq, created right after prev (NULL = in front) if the next one has another count
+static LFUBucket *lfuBucketAfter(BufferClass *bf, LFUBucket *prev, long long freq)
+{
+    LFUBucket *next = prev != NULL ? prev->next : bf->lfuLowest;
+
+    if (next != NULL && next->freq == freq)
+        return next;
+
+    LFUBucket *bucket = bf->lfuSpare;
+    bf->lfuSpare = bucket->next;
+
+    bucket->freq = freq;
+    bucket->first = bucket->last = NULL;
+    bucket->prev = prev;
+    bucket->next = next;
+    if (prev != NULL)
+        prev->next = bucket;
     else
+        bf->lfuLowest = bucket;
+    if (next != NULL)
+        next->prev = bucket;
+
+    return bucket;
+}
+
+static void lfuAppend(LFUBucket *bucket, BMFrame *pt)
+{
+    pt->bucket = bucket;
+    pt->listPrev = bucket->last;
+    pt->listNext = NULL;
+    if (bucket->last != NULL)
+        bucket->last->listNext = pt;
+    else
+        bucket->first = pt;
+    bucket->last = pt;
+}
+
+// takes the frame out of its bucket and returns the bucket a new count has to follow
+static LFUBucket *lfuDetach(BufferClass *bf, BMFrame *pt)
+{
+    LFUBucket *bucket = pt->bucket;
+
+    if (pt->listPrev != NULL)
+        pt->listPrev->listNext = pt->listNext;
+    else
+        bucket->first = pt->listNext;
+    if (pt->listNext != NULL)
+        pt->listNext->listPrev = pt->listPrev;
+    else
+        bucket->last = pt->listPrev;
+
+    if (bucket->first != NULL)
+        return bucket;
+
+    LFUBucket *prev = bucket->prev;
+    if (prev != NULL)
+        prev->next = bucket->next;
+    else
+        bf->lfuLowest = bucket->next;
+    if (bucket->next != NULL)
+        bucket->next->prev = prev;
+
+    bucket->next = bf->lfuSpare;
+    bf->lfuSpare = bucket;
+    return prev;
+}
+
+// halving keeps the order of the buckets, neighbours that end up with the same count merge
+static void lfuAge(BufferClass *bf)
+{
+    LFUBucket *kept = NULL;
+
+    for (LFUBucket *bucket = bf->lfuLowest, *next; bucket != NULL; bucket = next)
+    {
+        next = bucket->next;
+        bucket->freq /= 2;
+
+        if (kept == NULL || kept->freq != bucket->freq)
+        {
+            kept = bucket;
+            continue;
+        }
+
+        for (BMFrame *pt = bucket->first; pt != NULL; pt = pt->listNext)
+            pt->bucket = kept;
+        kept->last->listNext = bucket->first;
+        bucket->first->listPrev = kept->last;
+        kept->last = bucket->last;
+
+        kept->next = next;
+        if (next != NULL)
+            next->prev = kept;
+        bucket->next = bf->lfuSpare;
+        bf->lfuSpare = bucket;
+    }
+}
+
+static void lfuTick(BufferClass *bf)
+{
+    if (bf->lfu.agingPeriod > 0 && ++bf->lfuPins % bf->lfu.agingPeriod == 0)
+        lfuAge(bf);
+}
+
+static void lfuHit(BufferClass *bf, BMFrame *pt)
+{
+    long long freq = pt->bucket->freq + 1;
+
+    lfuAppend(lfuBucketAfter(bf, lfuDetach(bf, pt), freq), pt);
+    lfuTick(bf);
+}
+
+static BMFrame *lfuVictim(BufferClass *bf)
+{
+    BMFrame *pt = NULL;
+
+    for (LFUBucket *bucket = bf->lfuLowest; bucket != NULL && pt == NULL; bucket = bucket->next)
     {
-        LRUSetter(bf,ptr,page,pageNum);   
+        for (pt = bucket->first; pt != NULL && pinCount(pt) > 0; pt = pt->listNext)
+            ;
     }
+
+    return pt;
+}
+
+static void lfuLoad(BufferClass *bf, BMFrame *pt)
+{
+    // a new page starts with one reference, right after the buckets of aged out pages
+    lfuDetach(bf, pt);
+    LFUBucket *prev = bf->lfuLowest != NULL && bf->lfuLowest->freq < 1 ? bf->lfuLowest : NULL;
+    lfuAppend(lfuBucketAfter(bf, prev, 1), pt);
+    lfuTick(bf);
+}
+
+// an empty frame goes in front of a count of 0, lfuVictim takes it next
+static void lfuEmpty(BufferClass *bf, BMFrame *pt)
+{
+    lfuDetach(bf, pt);
+    LFUBucket *bucket = lfuBucketAfter(bf, NULL, 0);
+
+    pt->bucket = bucket;
+    pt->listPrev = NULL;
+    pt->listNext = bucket->first;
+    if (bucket->first != NULL)
+        bucket->first->listPrev = pt;
+    else
+        bucket->last = pt;
+    bucket->first = pt;
+}
+
+static RC lfuInit(BufferClass *bf, BM_LFUParams *params)
+{
+    BM_LFUParams defaults = {0};
+
+    bf->lfu = params != NULL ? *params : defaults;
+    if (bf->lfu.agingPeriod < 0)
+        return RC_INVALID_ARGUMENT;
+
+    bf->lfuBlock = malloc(bf->numFrames * sizeof(LFUBucket));
+    if (bf->lfuBlock == NULL)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    for (int i = 0; i < bf->numFrames; i++)
+        bf->lfuBlock[i].next = i + 1 < bf->numFrames ? &bf->lfuBlock[i + 1] : NULL;
+    bf->lfuSpare = bf->lfuBlock;
+
+    // empty frames start with a count of 0 so they are used before anything is evicted
+    LFUBucket *empty = lfuBucketAfter(bf, NULL, 0);
+    for (statlist *sptr = bf->stathead; sptr != NULL; sptr = sptr->next)
+        lfuAppend(empty, sptr->fpt);
+
     return RC_OK;
 }
 
-RC clock_buffer (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum)
+/* ARC (Megiddo and Modha): T1 holds pages referenced once and T2 pages
+   referenced again since they were loaded. B1 and B2 remember the pages
+   recently evicted from them. A miss that finds its page in B1 shows T1
+   was too small and raises the target size p of T1, a B2 ghost lowers it,
+   so the recency/frequency split follows the workload. */
+
+static void arcPush(ARCList *list, BMFrame *pt)
 {
-    BMFrame* isPinned = checkPinned(bm,pageNum);
+    pt->arcList = list;
+    pt->listPrev = list->last;
+    pt->listNext = NULL;
+    if (list->last != NULL)
+        list->last->listNext = pt;
+    else
+        list->first = pt;
+    list->last = pt;
+    list->length++;
+}
 
-    if (isPinned!=NULL) return RC_OK;
+static void arcUnlink(BMFrame *pt)
+{
+    ARCList *list = pt->arcList;
 
-    BufferClass *bf = getBMmgmt(bm);;
-    BMFrame *pt = bf->pointer->next;
-    bool notfound = false;
-    
-    do{
-         if (pt->fixCount == 0)
+    if (pt->listPrev != NULL)
+        pt->listPrev->listNext = pt->listNext;
+    else
+        list->first = pt->listNext;
+    if (pt->listNext != NULL)
+        pt->listNext->listPrev = pt->listPrev;
+    else
+        list->last = pt->listPrev;
+    list->length--;
+}
+
+static void ghostPush(ARCGhostList *list, ARCGhost *ghost)
+{
+    ghost->list = list;
+    ghost->prev = list->last;
+    ghost->next = NULL;
+    if (list->last != NULL)
+        list->last->next = ghost;
+    else
+        list->first = ghost;
+    list->last = ghost;
+    list->length++;
+}
+
+static void ghostUnlink(ARCGhost *ghost)
+{
+    ARCGhostList *list = ghost->list;
+
+    if (ghost->prev != NULL)
+        ghost->prev->next = ghost->next;
+    else
+        list->first = ghost->next;
+    if (ghost->next != NULL)
+        ghost->next->prev = ghost->prev;
+    else
+        list->last = ghost->prev;
+    list->length--;
+}
+
+static void ghostDrop(BufferClass *bf, ARCGhost *ghost)
+{
+    tableRemove(&bf->ghostTable, &ghost->page);
+    ghostUnlink(ghost);
+    ghost->page = NO_PAGE;
+    ghostPush(&bf->arcSpare, ghost);
+}
+
+static void ghostRemember(BufferClass *bf, ARCGhostList *list, PageNumber pageNum)
+{
+    // pinned pages can push ARC past its bounds, then the oldest ghost makes room
+    if (bf->arcSpare.first == NULL)
+        ghostDrop(bf, bf->arcB2.first != NULL ? bf->arcB2.first : bf->arcB1.first);
+
+    ARCGhost *ghost = bf->arcSpare.first;
+    ghostUnlink(ghost);
+    ghost->page = pageNum;
+    ghostPush(list, ghost);
+    tableInsert(&bf->ghostTable, &ghost->page);
+}
+
+static BMFrame *arcOldestUnpinned(ARCList *list)
+{
+    BMFrame *pt = list->first;
+
+    while (pt != NULL && pinCount(pt) > 0)
+        pt = pt->listNext;
+
+    return pt;
+}
+
+// the target size of T1 after a miss on pageNum: a B1 ghost grows it, a B2 ghost shrinks it
+static int arcAdaptedTarget(BufferClass *bf, ARCGhost *ghost)
+{
+    int c = bf->numFrames;
+
+    if (ghost == NULL)
+        return bf->arcTarget;
+
+    if (ghost->list == &bf->arcB1)
+    {
+        int delta = bf->arcB2.length > bf->arcB1.length ? bf->arcB2.length / bf->arcB1.length : 1;
+        return bf->arcTarget + delta < c ? bf->arcTarget + delta : c;
+    }
+
+    int delta = bf->arcB1.length > bf->arcB2.length ? bf->arcB1.length / bf->arcB2.length : 1;
+    return bf->arcTarget - delta > 0 ? bf->arcTarget - delta : 0;
+}
+
+// ARC's REPLACE: evict from T1 while it is above its target, otherwise from T2;
+// when every page of the chosen list is pinned the other list gives the victim
+static BMFrame *arcVictim(BufferClass *bf, PageNumber pageNum)
+{
+    ARCList *t1 = &bf->arcT1;
+
+    if (bf->arcFree.first != NULL)
+        return bf->arcFree.first;
+
+    ARCGhost *ghost = (ARCGhost *)tableFind(&bf->ghostTable, pageNum);
+    bool inB2 = ghost != NULL && ghost->list == &bf->arcB2;
+    int target = arcAdaptedTarget(bf, ghost);
+
+    bool fromT1 = t1->length > 0 && (t1->length > target || (inB2 && t1->length == target));
+    BMFrame *pt = arcOldestUnpinned(fromT1 ? t1 : &bf->arcT2);
+    if (pt == NULL)
+        pt = arcOldestUnpinned(fromT1 ? &bf->arcT2 : t1);
+
+    return pt;
+}
+
+static void arcHit(BufferClass *bf, BMFrame *pt)
+{
+    arcUnlink(pt);
+    arcPush(&bf->arcT2, pt);
+}
+
+static void arcLoad(BufferClass *bf, BMFrame *pt, PageNumber pageNum)
+{
+    int c = bf->numFrames;
+    ARCGhost *ghost = (ARCGhost *)tableFind(&bf->ghostTable, pageNum);
+    ARCList *target = &bf->arcT2;
+    bool remember = true;
+
+    bf->arcTarget = arcAdaptedTarget(bf, ghost);
+
+    if (ghost == NULL)
+    {
+        // a new page: T1 and B1 together stay within c pages, all four lists within 2c
+        target = &bf->arcT1;
+        if (bf->arcT1.length + bf->arcB1.length >= c)
         {
-            if (!pt->refbit) //refbit = 0
-            {
-                notfound = true;
-                break;
-            }
-            pt->refbit = false; //on the way set all bits to 0
+            if (bf->arcB1.first != NULL)
+                ghostDrop(bf, bf->arcB1.first);
+            else
+                remember = false;
+        }
+        else if (bf->arcT1.length + bf->arcT2.length + bf->arcB1.length + bf->arcB2.length >= 2 * c &&
+                 bf->arcB2.first != NULL)
+        {
+            ghostDrop(bf, bf->arcB2.first);
         }
-        pt = pt->next;
     }
-    while (pt!=bf->pointer);
-    
-    if (!notfound) return RC_IM_NO_MORE_ENTRIES; //no avaliable BMFrame
-    
-    
-    if (pinCurrentPage(pageNum,pt, bm)!=RC_OK) return RC_ERROR;
-    
-    bf->pointer = pt;
-    page->pageNum = pageNum;
-    page->data = pt->data;
-    
+    else
+    {
+        ghostDrop(bf, ghost);
+    }
+
+    ARCList *from = pt->arcList;
+    arcUnlink(pt);
+    if (pt->currpage != NO_PAGE && remember)
+        ghostRemember(bf, from == &bf->arcT1 ? &bf->arcB1 : &bf->arcB2, pt->currpage);
+    arcPush(target, pt);
+}
+
+static RC arcInit(BufferClass *bf)
+{
+    bf->arcGhosts = malloc(bf->numFrames * sizeof(ARCGhost));
+    if (bf->arcGhosts == NULL || tableCreate(&bf->ghostTable, bf->numFrames) != RC_OK)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    for (int i = 0; i < bf->numFrames; i++)
+    {
+        bf->arcGhosts[i].page = NO_PAGE;
+        ghostPush(&bf->arcSpare, &bf->arcGhosts[i]);
+    }
+
+    for (statlist *sptr = bf->stathead; sptr != NULL; sptr = sptr->next)
+        arcPush(&bf->arcFree, sptr->fpt);
+
     return RC_OK;
 }
 
-
+
+/* Sequential ring (like PostgreSQL's bulk read strategy): sequential misses
+   take their frames from the strategy only until the ring is full, after
+   that each one recycles the ring's oldest frame if it is unpinned. Ring
+   frames keep their place in the strategy's lists, so the working set
+   around them is left alone. The ring is under stratLock. */
+
+// the frame the next sequential miss recycles, NULL = take a victim from the strategy
+static BMFrame *ringVictim(BufferClass *bf)
+{
+    BMFrame *pt = bf->ring[bf->ringNext];
+
+    return pt != NULL && pinCount(pt) == 0 ? pt : NULL;
+}
+
+static void ringLeave(BufferClass *bf, BMFrame *pt)
+{
+    int slot = __atomic_load_n(&pt->ringSlot, __ATOMIC_RELAXED);
+
+    if (slot < 0)
+        return;
+
+    bf->ring[slot] = NULL;
+    __atomic_store_n(&pt->ringSlot, -1, __ATOMIC_RELAXED);
+}
+
+// pt replaces the frame in the next slot, which goes back to the shared pool
+static void ringInstall(BufferClass *bf, BMFrame *pt)
+{
+    if (bf->ring[bf->ringNext] != NULL)
+        ringLeave(bf, bf->ring[bf->ringNext]);
+    ringLeave(bf, pt);
+
+    bf->ring[bf->ringNext] = pt;
+    __atomic_store_n(&pt->ringSlot, bf->ringNext, __ATOMIC_RELAXED);
+    bf->ringNext = (bf->ringNext + 1) % bf->ringSize;
+}
+
+static RC ringInit(BufferClass *bf)
+{
+    bf->ringSize = bf->numFrames / 8 < BM_RING_FRAMES ? bf->numFrames / 8 : BM_RING_FRAMES;
+    if (bf->ringSize < 1)
+        bf->ringSize = 1;
+
+    bf->ring = calloc(bf->ringSize, sizeof(BMFrame *));
+    return bf->ring != NULL ? RC_OK : RC_MEMORY_ALLOCATION_FAILED;
+}
+
+/* Pinning: a hit pins its frame under the page's stripe latch and touches
+   no other shared state unless the strategy keeps references. A miss picks
+   and claims a victim under stratLock, then reads the page holding only the
+   frame's latch exclusively, so hits on the page wait for the read while
+   hits and misses on other pages go on. */
+
+// a reference by a random pin; a ring frame joins the shared pool, and as the
+// strategy has not seen the pages the ring recycled, that counts as a reference
+static void strategyHit(BufferClass *bf, ReplacementStrategy strat, BMFrame *pt, bool reference)
+{
+    bool inRing = __atomic_load_n(&pt->ringSlot, __ATOMIC_RELAXED) >= 0;
+
+    // FIFO and CLOCK ignore hits, so their hits on shared frames never take stratLock
+    if (!inRing && (!reference || strat == RS_FIFO || strat == RS_CLOCK))
+        return;
+
+    pthread_mutex_lock(&bf->stratLock);
+    ringLeave(bf, pt);
+    if (strat == RS_LRU)
+        moveToTail(bf, pt);
+    else if (strat == RS_LRU_K)
+        lrukReference(bf, pt);
+    else if (strat == RS_LFU)
+        lfuHit(bf, pt);
+    else if (strat == RS_ARC)
+        arcHit(bf, pt);
+    pthread_mutex_unlock(&bf->stratLock);
+}
+
+static BMFrame *strategyVictim(BufferClass *bf, ReplacementStrategy strat, PageNumber pageNum)
+{
+    switch (strat)
+    {
+    case RS_FIFO:
+    case RS_LRU:
+        return fifoVictim(bf);
+    case RS_CLOCK:
+        return clockVictim(bf);
+    case RS_LRU_K:
+        return lrukVictim(bf);
+    case RS_LFU:
+        return lfuVictim(bf);
+    case RS_ARC:
+        return arcVictim(bf, pageNum);
+    }
+
+    return NULL;
+}
+
+static void strategyLoad(BufferClass *bf, ReplacementStrategy strat, BMFrame *pt, PageNumber pageNum)
+{
+    switch (strat)
+    {
+    case RS_FIFO:
+    case RS_LRU:
+        moveToTail(bf, pt);
+        break;
+    case RS_CLOCK:
+        bf->pointer = pt;
+        break;
+    case RS_LRU_K:
+        lrukLoad(bf, pt, pageNum);
+        break;
+    case RS_LFU:
+        lfuLoad(bf, pt);
+        break;
+    case RS_ARC:
+        arcLoad(bf, pt, pageNum);
+        break;
+    }
+}
+
+// undoes strategyLoad for a frame that ended up empty, so it is the next victim
+// and takes up no place in the strategy's lists; loaded is the page strategyLoad
+// was told about, NO_PAGE if the frame came from the ring without it
+static void strategyEmpty(BufferClass *bf, ReplacementStrategy strat, BMFrame *pt, PageNumber loaded)
+{
+    ringLeave(bf, pt);
+
+    switch (strat)
+    {
+    case RS_FIFO:
+    case RS_LRU:
+        moveToHead(bf, pt);
+        break;
+    case RS_CLOCK:
+        pt->refbit = false;
+        bf->pointer = pt->prev;
+        break;
+    case RS_LRU_K:
+        lrukEmpty(bf, pt, loaded);
+        break;
+    case RS_LFU:
+        lfuEmpty(bf, pt);
+        break;
+    case RS_ARC:
+        arcUnlink(pt);
+        arcPush(&bf->arcFree, pt);
+        break;
+    }
+}
+
+// results of claimFrame
+#define CLAIM_TAKEN 0 // the frame is pinned and out of the page table
+#define CLAIM_PINNED 1 // the frame was pinned since the strategy picked it
+#define CLAIM_DIRTY 2 // the frame is pinned for writing and still holds its page
+
+static int claimFrame(BufferClass *bf, BMFrame *pt)
+{
+    PageNumber victim = pt->currpage;
+
+    // an empty frame is in no page table, so only a miss holding stratLock can pin it
+    if (victim == NO_PAGE)
+    {
+        __atomic_store_n(&pt->fixCount, 1, __ATOMIC_RELEASE);
+        return CLAIM_TAKEN;
+    }
+
+    PageStripe *stripe = stripeOf(bf, victim);
+    int claim = CLAIM_TAKEN;
+
+    pthread_mutex_lock(&stripe->latch);
+    if (pinCount(pt) != 0)
+        claim = CLAIM_PINNED;
+    else if (__atomic_load_n(&pt->isdirty, __ATOMIC_ACQUIRE))
+        claim = CLAIM_DIRTY;
+    else
+    {
+        tableRemove(&stripe->table, &pt->currpage);
+        if (__atomic_exchange_n(&pt->prefetched, 0, __ATOMIC_RELAXED))
+            __atomic_add_fetch(&bf->numPrefetchUnused, 1, __ATOMIC_RELAXED);
+    }
+
+    if (claim != CLAIM_PINNED)
+        __atomic_store_n(&pt->fixCount, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&stripe->latch);
+
+    return claim;
+}
+
+// reads pageNum into a victim frame; *frame stays NULL when the pin has to start over
+static RC loadPage(BufferClass *bf, ReplacementStrategy strat, PageNumber pageNum, BM_AccessPattern pattern,
+                   bool prefetch, BMFrame **frame)
+{
+    BMFrame *pt;
+    bool recycled;
+    int claim;
+
+    *frame = NULL;
+    pthread_mutex_lock(&bf->stratLock);
+    do
+    {
+        pt = pattern == BM_ACCESS_SEQUENTIAL ? ringVictim(bf) : NULL;
+        recycled = pt != NULL;
+        if (pt == NULL)
+            pt = strategyVictim(bf, strat, pageNum);
+        if (pt == NULL)
+        {
+            pthread_mutex_unlock(&bf->stratLock);
+            return RC_ERROR_PINNING_PAGE;
+        }
+        claim = claimFrame(bf, pt);
+    } while (claim == CLAIM_PINNED);
+
+    // a dirty victim is written without stratLock so other misses go on meanwhile,
+    // and a background writer that fell behind starts its next round right away
+    if (claim == CLAIM_DIRTY)
+    {
+        pthread_mutex_unlock(&bf->stratLock);
+
+        pthread_rwlock_rdlock(&pt->latch);
+        RC writeValue = poolWrite(bf, pt);
+        pthread_rwlock_unlock(&pt->latch);
+        releasePin(pt);
+
+        __atomic_add_fetch(&bf->numEvictWrite, 1, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&bf->writerLock);
+        if (bf->writerRunning)
+            pthread_cond_signal(&bf->writerWake);
+        pthread_mutex_unlock(&bf->writerLock);
+
+        return writeValue == RC_OK ? RC_OK : RC_ERROR_PINNING_PAGE;
+    }
+
+    // a random miss may take a ring frame, which then leaves the ring
+    if (recycled)
+        bf->ringNext = (bf->ringNext + 1) % bf->ringSize;
+    else
+    {
+        strategyLoad(bf, strat, pt, pageNum);
+        if (pattern == BM_ACCESS_SEQUENTIAL)
+            ringInstall(bf, pt);
+        else
+            ringLeave(bf, pt);
+    }
+    pthread_mutex_unlock(&bf->stratLock);
+
+    // nobody latches an unpinned frame, so this never waits
+    pthread_rwlock_wrlock(&pt->latch);
+
+    PageStripe *stripe = stripeOf(bf, pageNum);
+    pthread_mutex_lock(&stripe->latch);
+    if (tableFind(&stripe->table, pageNum) != NULL)
+    {
+        // another miss loaded the page meanwhile, the frame is left empty
+        __atomic_store_n(&pt->currpage, NO_PAGE, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&stripe->latch);
+        pthread_rwlock_unlock(&pt->latch);
+
+        pthread_mutex_lock(&bf->stratLock);
+        strategyEmpty(bf, strat, pt, recycled ? NO_PAGE : pageNum);
+        pthread_mutex_unlock(&bf->stratLock);
+        releasePin(pt);
+        return RC_OK;
+    }
+
+    // hits that find the page from here on wait for the read on the frame latch
+    __atomic_store_n(&pt->loading, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&pt->currpage, pageNum, __ATOMIC_RELAXED);
+    pt->pageLSN = 0;
+    __atomic_store_n(&pt->isdirty, false, __ATOMIC_RELAXED);
+    __atomic_store_n(&pt->prefetched, prefetch, __ATOMIC_RELAXED);
+    RC result = tableInsert(&stripe->table, &pt->currpage);
+    pthread_mutex_unlock(&stripe->latch);
+
+    if (result == RC_OK && poolRead(bf, pageNum, pt->data) != RC_OK)
+    {
+        pthread_mutex_lock(&stripe->latch);
+        tableRemove(&stripe->table, &pt->currpage);
+        pthread_mutex_unlock(&stripe->latch);
+        result = RC_ERROR_PINNING_PAGE;
+    }
+
+    // waiters check currpage after the latch, a failed read leaves the frame empty
+    if (result != RC_OK)
+        __atomic_store_n(&pt->currpage, NO_PAGE, __ATOMIC_RELAXED);
+    __atomic_store_n(&pt->loading, 0, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&pt->latch);
+
+    if (result != RC_OK)
+    {
+        pthread_mutex_lock(&bf->stratLock);
+        strategyEmpty(bf, strat, pt, recycled ? NO_PAGE : pageNum);
+        pthread_mutex_unlock(&bf->stratLock);
+        releasePin(pt);
+        return result;
+    }
+
+    *frame = pt;
+    return RC_OK;
+}
+
+
+/* Background writer: every round it looks at the unpinned frames in the
+   order the strategy would evict them and writes the dirty ones among the
+   first cleanPercent of the pool, so the victims of the coming misses are
+   clean. It pins what it writes, like forceFlushPool, but never counts as a
+   reference. */
+
+// LRU-K evicts the oldest K-th newest reference first, empty frames before any
+static int lrukBefore(BufferClass *bf, BMFrame *a, BMFrame *b)
+{
+    int k = bf->lruk.k;
+
+    if ((a->currpage == NO_PAGE) != (b->currpage == NO_PAGE))
+        return a->currpage == NO_PAGE;
+
+    return a->history[k - 1] < b->history[k - 1] ||
+           (a->history[k - 1] == b->history[k - 1] && a->history[0] < b->history[0]);
+}
+
+static int collectUnpinned(BMFrame *pt, BMFrame **frames, int count, int max)
+{
+    for (; pt != NULL && count < max; pt = pt->listNext)
+    {
+        if (pinCount(pt) == 0)
+            frames[count++] = pt;
+    }
+
+    return count;
+}
+
+// up to max unpinned frames in the order the strategy would evict them, called under stratLock
+static int nextVictims(BufferClass *bf, ReplacementStrategy strat, BMFrame **frames, int max)
+{
+    int count = 0;
+
+    if (strat == RS_FIFO || strat == RS_LRU || strat == RS_CLOCK)
+    {
+        BMFrame *start = strat == RS_CLOCK ? bf->pointer->next : bf->head;
+        BMFrame *pt = start;
+
+        do
+        {
+            if (pinCount(pt) == 0)
+                frames[count++] = pt;
+            pt = pt->next;
+        } while (pt != start && count < max);
+    }
+    else if (strat == RS_LFU)
+    {
+        for (LFUBucket *bucket = bf->lfuLowest; bucket != NULL && count < max; bucket = bucket->next)
+            count = collectUnpinned(bucket->first, frames, count, max);
+    }
+    else if (strat == RS_ARC)
+    {
+        bool t1First = bf->arcT1.length > bf->arcTarget;
+
+        count = collectUnpinned(t1First ? bf->arcT1.first : bf->arcT2.first, frames, count, max);
+        count = collectUnpinned(t1First ? bf->arcT2.first : bf->arcT1.first, frames, count, max);
+    }
+    else if (strat == RS_LRU_K)
+    {
+        // insertion into a sorted window of the max next victims
+        for (statlist *sptr = bf->stathead; sptr != NULL; sptr = sptr->next)
+        {
+            BMFrame *pt = sptr->fpt;
+
+            if (pinCount(pt) != 0 || (count == max && !lrukBefore(bf, pt, frames[max - 1])))
+                continue;
+
+            int i = count < max ? count++ : max - 1;
+            for (; i > 0 && lrukBefore(bf, pt, frames[i - 1]); i--)
+                frames[i] = frames[i - 1];
+            frames[i] = pt;
+        }
+    }
+
+    return count;
+}
+
+static void writerRound(BM_BufferPool *const bm, BMFrame **frames, PageNumber *pages)
+{
+    BufferClass *bf = getBMmgmt(bm);
+    BM_WriterParams *params = &bf->writerParams;
+    int window = bf->numFrames * params->cleanPercent / 100;
+    int limit = params->maxPagesPerRound > 0 ? params->maxPagesPerRound : bf->numFrames;
+    int numDirty = 0;
+
+    pthread_mutex_lock(&bf->stratLock);
+    int count = nextVictims(bf, bm->strategy, frames, window > 0 ? window : 1);
+    for (int i = 0; i < count && numDirty < limit; i++)
+    {
+        if (frames[i]->currpage != NO_PAGE && __atomic_load_n(&frames[i]->isdirty, __ATOMIC_ACQUIRE))
+        {
+            frames[numDirty] = frames[i];
+            pages[numDirty++] = frames[i]->currpage;
+        }
+    }
+    pthread_mutex_unlock(&bf->stratLock);
+
+    // the frames are pinned one at a time, a frame that moved on to another page is passed over
+    for (int i = 0; i < numDirty; i++)
+    {
+        BMFrame *pt = pinResident(bf, pages[i]);
+
+        if (pt == frames[i])
+        {
+            pthread_rwlock_rdlock(&pt->latch);
+            if (pt->currpage == pages[i] && __atomic_load_n(&pt->isdirty, __ATOMIC_ACQUIRE))
+                poolWrite(bf, pt);
+            pthread_rwlock_unlock(&pt->latch);
+        }
+        if (pt != NULL)
+            releasePin(pt);
+    }
+}
+
+static void *poolWriter(void *arg)
+{
+    BM_BufferPool *bm = arg;
+    BufferClass *bf = getBMmgmt(bm);
+    BMFrame **frames = malloc(bf->numFrames * sizeof(BMFrame *));
+    PageNumber *pages = malloc(bf->numFrames * sizeof(PageNumber));
+
+    pthread_mutex_lock(&bf->writerLock);
+    while (!bf->writerStop && frames != NULL && pages != NULL)
+    {
+        pthread_mutex_unlock(&bf->writerLock);
+        writerRound(bm, frames, pages);
+        pthread_mutex_lock(&bf->writerLock);
+
+        if (bf->writerStop)
+            break;
+
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += bf->writerParams.intervalMillis / 1000;
+        until.tv_nsec += (long)(bf->writerParams.intervalMillis % 1000) * 1000000;
+        if (until.tv_nsec >= 1000000000)
+        {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&bf->writerWake, &bf->writerLock, &until);
+    }
+    pthread_mutex_unlock(&bf->writerLock);
+
+    free(frames);
+    free(pages);
+    return NULL;
+}
+
+
+/* Prefetching: prefetchPages queues page numbers and a background thread per
+   pool loads them like a miss would, but unpins the frame right away and
+   marks it prefetched. */
+
+static void prefetchPage(BufferClass *bf, ReplacementStrategy strat, PrefetchRequest request)
+{
+    BMFrame *pt = NULL;
+
+    while (pt == NULL)
+    {
+        if (findFrame(bf, request.page) != NULL ||
+            loadPage(bf, strat, request.page, request.pattern, true, &pt) != RC_OK)
+            return;
+    }
+
+    releasePin(pt);
+    __atomic_add_fetch(&bf->numPrefetchRead, 1, __ATOMIC_RELAXED);
+}
+
+static void *poolPrefetcher(void *arg)
+{
+    BM_BufferPool *bm = arg;
+    BufferClass *bf = getBMmgmt(bm);
+
+    pthread_mutex_lock(&bf->prefetchLock);
+    while (!bf->prefetchStop)
+    {
+        if (bf->prefetchCount == 0)
+        {
+            pthread_cond_wait(&bf->prefetchWake, &bf->prefetchLock);
+            continue;
+        }
+
+        PrefetchRequest request = bf->prefetchQueue[bf->prefetchFirst];
+        bf->prefetchFirst = (bf->prefetchFirst + 1) % bf->numFrames;
+        bf->prefetchCount--;
+
+        pthread_mutex_unlock(&bf->prefetchLock);
+        prefetchPage(bf, bm->strategy, request);
+        pthread_mutex_lock(&bf->prefetchLock);
+    }
+    pthread_mutex_unlock(&bf->prefetchLock);
+
+    return NULL;
+}
+
+// releases the file, the frames, the tables and the locks of a pool, also a partly built one
+static void freePool(BufferClass *bf)
+{
+    if (bf->fHandle.mgmtInfo != NULL)
+        closePageFile(&bf->fHandle);
+
+    while (bf->stathead != NULL)
+    {
+        statlist *next = bf->stathead->next;
+        pthread_rwlock_destroy(&bf->stathead->fpt->latch);
+        free(bf->stathead->fpt->data);
+        free(bf->stathead->fpt);
+        free(bf->stathead);
+        bf->stathead = next;
+    }
+    for (int i = 0; i < BM_STRIPES; i++)
+    {
+        pthread_mutex_destroy(&bf->stripes[i].latch);
+        free(bf->stripes[i].table.slots);
+    }
+    pthread_rwlock_destroy(&bf->fileLock);
+    pthread_mutex_destroy(&bf->stratLock);
+    pthread_mutex_destroy(&bf->writerLock);
+    pthread_cond_destroy(&bf->writerWake);
+    pthread_mutex_destroy(&bf->prefetchLock);
+    pthread_cond_destroy(&bf->prefetchWake);
+    free(bf->prefetchQueue);
+    free(bf->ring);
+    free(bf->ghosts);
+    free(bf->ghostHeap);
+    free(bf->historyBlock);
+    free(bf->lfuBlock);
+    free(bf->arcGhosts);
+    free(bf->ghostTable.slots);
+    free(bf);
+}
+
+static void stopPrefetcher(BufferClass *bf)
+{
+    pthread_mutex_lock(&bf->prefetchLock);
+    bool running = bf->prefetcherRunning;
+    bf->prefetchStop = true;
+    pthread_cond_signal(&bf->prefetchWake);
+    pthread_mutex_unlock(&bf->prefetchLock);
+
+    if (!running)
+        return;
+
+    pthread_join(bf->prefetcher, NULL);
+    pthread_mutex_lock(&bf->prefetchLock);
+    bf->prefetcherRunning = false;
+    pthread_mutex_unlock(&bf->prefetchLock);
+}
 
 
 void bufferStarter(BufferClass *const bf, const int numPages, void *startData){
@@ -218,14 +1458,31 @@ void bufferStarter(BufferClass *const bf, const int numPages, void *startData){
   
 }
 
+static char *allocFrameData(int pageSize)
+{
+    char *data = NULL;
+
+    if (posix_memalign((void **)&data, SM_IO_ALIGNMENT, pageSize) != 0)
+        return NULL;
+
+    memset(data,'\0',pageSize);
+    return data;
+}
+
 RC bufferCreate(BufferClass *const bf , BMFrame *phead,statlist *shead){
     if (phead==NULL || shead ==NULL || bf == NULL) return RC_WRITE_FAILED;
     
     phead->fixCount=0;
+    phead->pageLSN=0;
     phead->refbit=false;
     phead->isdirty=false;
+    phead->loading=0;
+    phead->prefetched=0;
+    phead->ringSlot=-1;
+    pthread_rwlock_init(&phead->latch, NULL);
 
-    memset(phead->data,'\0',PAGE_SIZE);
+    phead->data = allocFrameData(bf->pageSize);
+    if (phead->data==NULL) return RC_WRITE_FAILED;
     shead->fpt = phead;
     bf->head = phead;
 
@@ -237,37 +1494,62 @@ RC bufferCreate(BufferClass *const bf , BMFrame *phead,statlist *shead){
     
 }
 
-RC initBufferPool(BM_BufferPool *const bm, const char *const fileName, const int numPages, ReplacementStrategy strat,  void *startData)
-//initialization: create page frames using circular list; init bm;
+// opens the file and builds the frame list; every frame is on the statlist as
+// soon as it exists, so on failure freePool releases whatever was set up
+static RC buildPool(BufferClass *bf, const char *fileName, int numPages, BM_PoolParams *params)
 {
-    BufferClass *bf = calloc(bm->numPages ,sizeof(BufferClass));
+    // the pool keeps its page file open until shutdownBufferPool, frames take the file's page size;
+    // frame data is SM_IO_ALIGNMENT aligned, so frames go to a direct handle without a bounce
+    RC openValue;
+    if (params != NULL && params->space != NULL)
+        openValue = openRelation(params->space, (char *)fileName, &bf->fHandle);
+    else if (params != NULL && params->directIO)
+        openValue = openPageFileDirect((char *)fileName, &bf->fHandle);
+    else
+        openValue = openPageFile((char *)fileName, &bf->fHandle);
+    if (openValue != RC_OK)
+        return openValue;
+    bf->pageSize = getPageSize(&bf->fHandle);
+    bf->compressed = isCompressed(&bf->fHandle);
 
-    //error check
-    if (numPages<=0)   return RC_WRITE_FAILED;
-    //init bf:bookkeeping data
-    
-    if (bf==NULL) return RC_BUFFER_NOT_INIT;
-   
-    bufferStarter(bf,numPages,startData);
+    for (int i = 0; i < BM_STRIPES; i++)
+    {
+        if (tableCreate(&bf->stripes[i].table, numPages / BM_STRIPES + 1) != RC_OK) return RC_WRITE_FAILED;
+    }
     //create list
     int k=0;
-    statlist *shead = malloc( sizeof(statlist));
-    BMFrame *phead = malloc(sizeof(BMFrame));
-    if (phead==NULL) return RC_WRITE_FAILED;
+    statlist *shead = calloc(1, sizeof(statlist));
+    BMFrame *phead = calloc(1, sizeof(BMFrame));
+    if (phead==NULL || shead==NULL)
+    {
+        free(phead);
+        free(shead);
+        return RC_WRITE_FAILED;
+    }
+    shead->fpt = phead;
+    bf->stathead = shead;
 
-   bufferCreate(bf, phead,shead);
+   if (bufferCreate(bf, phead,shead)!=RC_OK) return RC_WRITE_FAILED;
 
     while (++k<numPages) { 
-        BMFrame *newFrame = malloc(sizeof(BMFrame));
-        statlist *newStatList = malloc(sizeof(statlist));
+        BMFrame *newFrame = calloc(1, sizeof(BMFrame));
+        statlist *newStatList = calloc(1, sizeof(statlist));
+
+        if (newFrame==NULL || newStatList==NULL) {
+            free(newFrame);
+            free(newStatList);
+            break;
+        }
 
-        if (newFrame!=NULL) {
-        
-        
         newFrame->currpage=NO_PAGE;     
         newFrame->isdirty=false;   
         newFrame->refbit=false;  
         newFrame->fixCount=0;
+        newFrame->pageLSN=0;
+        newFrame->loading=0;
+        newFrame->prefetched=0;
+        newFrame->ringSlot=-1;
+        pthread_rwlock_init(&newFrame->latch, NULL);
         
         newStatList->fpt = newFrame;
 
@@ -279,17 +1561,11 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const fileName, const int
         newFrame->prev=phead;
         phead=newFrame;
 
-        memset(newFrame->data,'\0',4096);
-        }
-
-        else
-        return RC_WRITE_FAILED;
-
+        newFrame->data = allocFrameData(bf->pageSize);
+        if (newFrame->data==NULL) return RC_WRITE_FAILED;
     }
-    bm->mgmtData = bf;
-    bm->pageFile = (char *)fileName;
+    if (k<numPages) return RC_WRITE_FAILED;
 
-    shead->next = NULL;
     bf->tail = phead;
     bf->pointer = bf->head;
 
@@ -299,36 +1575,183 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const fileName, const int
     
     tail->next = aux->head;
     head->prev = tail;
-    
+
+    return RC_OK;
+}
+
+RC initBufferPool(BM_BufferPool *const bm, const char *const fileName, const int numPages, ReplacementStrategy strat,  void *startData)
+{
+    return initBufferPoolWithParams(bm, fileName, numPages, strat, startData, NULL);
+}
+
+RC initBufferPoolWithParams(BM_BufferPool *const bm, const char *const fileName, const int numPages,
+                            ReplacementStrategy strat, void *startData, BM_PoolParams *params)
+//initialization: create page frames using circular list; init bm;
+{
+    //error check
+    if (numPages<=0)   return RC_WRITE_FAILED;
+
+    BufferClass *bf = calloc(1, sizeof(BufferClass));
+    if (bf==NULL) return RC_BUFFER_NOT_INIT;
+   
+    //init bf:bookkeeping data
+    bufferStarter(bf,numPages,startData);
+
+    pthread_rwlock_init(&bf->fileLock, NULL);
+    pthread_mutex_init(&bf->stratLock, NULL);
+    pthread_mutex_init(&bf->writerLock, NULL);
+    pthread_cond_init(&bf->writerWake, NULL);
+    pthread_mutex_init(&bf->prefetchLock, NULL);
+    pthread_cond_init(&bf->prefetchWake, NULL);
+    for (int i = 0; i < BM_STRIPES; i++)
+        pthread_mutex_init(&bf->stripes[i].latch, NULL);
+
+    RC result = buildPool(bf, fileName, numPages, params);
+    if (result == RC_OK && strat == RS_LRU_K)
+        result = lrukInit(bf, startData);
+    else if (result == RC_OK && strat == RS_LFU)
+        result = lfuInit(bf, startData);
+    else if (result == RC_OK && strat == RS_ARC)
+        result = arcInit(bf);
+    if (result == RC_OK)
+        result = ringInit(bf);
+
+    if (result != RC_OK)
+    {
+        freePool(bf);
+        return result;
+    }
+
     //init bm
+    bm->mgmtData = bf;
+    bm->pageFile = (char *)fileName;
     bm->strategy = strat;
-   
     bm->numPages = numPages;
-    
+
+    return RC_OK;
+}
+
+RC setPoolLog(BM_BufferPool *const bm, WAL_Log *log)
+{
+    if (bm == NULL || bm->mgmtData == NULL)
+        return RC_BUFFER_POOL_NOT_INITIALIZED;
+
+    getBMmgmt(bm)->log = log;
+    return RC_OK;
+}
+
+RC startPoolWriter(BM_BufferPool *const bm, BM_WriterParams *params)
+{
+    BM_WriterParams defaults = {25, 64, 10};
+
+    if (bm == NULL || bm->mgmtData == NULL)
+        return RC_BUFFER_POOL_NOT_INITIALIZED;
+
+    BufferClass *bf = getBMmgmt(bm);
+    BM_WriterParams settings = params != NULL ? *params : defaults;
+
+    if (settings.cleanPercent < 0 || settings.cleanPercent > 100 || settings.maxPagesPerRound < 0 ||
+        settings.intervalMillis <= 0)
+        return RC_INVALID_ARGUMENT;
+
+    pthread_mutex_lock(&bf->writerLock);
+    RC result = RC_OK;
+    if (bf->writerRunning)
+        result = RC_WRITER_RUNNING;
+    else
+    {
+        bf->writerParams = settings;
+        bf->writerStop = false;
+        if (pthread_create(&bf->writer, NULL, poolWriter, bm) != 0)
+            result = RC_MEMORY_ALLOCATION_FAILED;
+        bf->writerRunning = result == RC_OK;
+    }
+    pthread_mutex_unlock(&bf->writerLock);
+
+    return result;
+}
+
+RC stopPoolWriter(BM_BufferPool *const bm)
+{
+    if (bm == NULL || bm->mgmtData == NULL)
+        return RC_BUFFER_POOL_NOT_INITIALIZED;
+
+    BufferClass *bf = getBMmgmt(bm);
+
+    pthread_mutex_lock(&bf->writerLock);
+    bool running = bf->writerRunning;
+    bf->writerStop = true;
+    pthread_cond_signal(&bf->writerWake);
+    pthread_mutex_unlock(&bf->writerLock);
+
+    if (!running)
+        return RC_OK;
+
+    pthread_join(bf->writer, NULL);
+
+    pthread_mutex_lock(&bf->writerLock);
+    bf->writerRunning = false;
+    pthread_mutex_unlock(&bf->writerLock);
+    return RC_OK;
+}
+
+RC logPageUpdate(BM_BufferPool *const bm, BM_PageHandle *const page, int offset, int length, LSN *lsn)
+{
+    if (bm == NULL || bm->mgmtData == NULL)
+        return RC_BUFFER_POOL_NOT_INITIALIZED;
+
+    BufferClass *bf = getBMmgmt(bm);
+
+    if (bf->log == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (offset < 0 || length <= 0 || offset + length > bf->pageSize)
+        return RC_INVALID_ARGUMENT;
+
+    BMFrame *pt = findFrame(bf, page->pageNum);
+    if (pt == NULL)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    LSN recordLSN;
+    RC result = logPageDelta(bf->log, page->pageNum, offset, length, pt->data + offset, &recordLSN);
+    if (result != RC_OK)
+        return result;
+
+    pt->pageLSN = recordLSN;
+    __atomic_store_n(&pt->isdirty, true, __ATOMIC_RELEASE);
+    if (lsn != NULL)
+        *lsn = recordLSN;
     return RC_OK;
 }
 
+int getPoolPageSize(BM_BufferPool *const bm)
+{
+    if (bm == NULL || bm->mgmtData == NULL)
+        return PAGE_SIZE;
+
+    return getBMmgmt(bm)->pageSize;
+}
+
+bool isPoolDirectIO(BM_BufferPool *const bm)
+{
+    if (bm == NULL || bm->mgmtData == NULL)
+        return false;
+
+    return isDirectIO(&getBMmgmt(bm)->fHandle) != 0;
+}
+
 RC shutdownBufferPool(BM_BufferPool *const bm)
 {
     BufferClass *bf = getBMmgmt(bm);;
-    BMFrame *pt = bf->head;
+    stopPrefetcher(bf);
+    stopPoolWriter(bm);
     RC flushValue = forceFlushPool(bm);
 
     if (flushValue!=RC_OK) {
         return flushValue;
     }
-   
-    
-    do{
-    pt = pt->next;
-        free(bf->head);
-        bf->head = pt;
-    }
-    while (pt!=bf->tail);
-
-    free(bf->tail);
-    free(bf);
 
+    freePool(bf);
 
     bm->pageFile = NULL;
     bm->mgmtData = NULL;    
@@ -337,50 +1760,147 @@ RC shutdownBufferPool(BM_BufferPool *const bm)
     return RC_OK;
 }
 
+static int compareFramePages(const void *a, const void *b)
+{
+    const BMFrame *x = *(BMFrame *const *)a;
+    const BMFrame *y = *(BMFrame *const *)b;
+
+    return (x->currpage > y->currpage) - (x->currpage < y->currpage);
+}
+
 RC forceFlushPool(BM_BufferPool *const bm)
 {
-    SM_FileHandle fHandle;
+    BufferClass *bf = getBMmgmt(bm);;
+
+    //collect dirty frames and sort them so neighbouring pages go out in one writeBlocks call
+    BMFrame **dirty = malloc(bf->numFrames * sizeof(BMFrame *));
+    BMFrame **busy = malloc(bf->numFrames * sizeof(BMFrame *));
+    SM_PageHandle *pages = malloc(bf->numFrames * sizeof(SM_PageHandle));
+    int numDirty = 0, numBusy = 0;
+
+    if (dirty == NULL || busy == NULL || pages == NULL)
+    {
+        free(dirty);
+        free(busy);
+        free(pages);
+        return RC_MEMORY_ALLOCATION_FAILED;
+    }
+
+    // each dirty frame is pinned and latched shared, so it keeps its page and data until
+    // written; the latch is only tried, waiting for it while holding others could deadlock
+    // with a latchPage caller, so frames latched elsewhere are left for one at a time below
+    LSN maxLSN = 0;
+    for (statlist *sptr = bf->stathead; sptr != NULL; sptr = sptr->next)
+    {
+        BMFrame *pt = sptr->fpt;
+        PageNumber pageNum = __atomic_load_n(&pt->currpage, __ATOMIC_RELAXED);
+
+        if (pageNum == NO_PAGE || !__atomic_load_n(&pt->isdirty, __ATOMIC_ACQUIRE))
+            continue;
+
+        // the frame may have moved on to another page since it was looked at
+        BMFrame *pinned = pinResident(bf, pageNum);
+        if (pinned != pt)
+        {
+            if (pinned != NULL)
+                releasePin(pinned);
+            continue;
+        }
 
-    if (openPageFile(bm->pageFile, &fHandle)!=RC_OK) {
-        return RC_ERROR;
+        if (pthread_rwlock_tryrdlock(&pt->latch) != 0)
+            busy[numBusy++] = pt;
+        else if (pt->currpage == pageNum && __atomic_load_n(&pt->isdirty, __ATOMIC_ACQUIRE))
+        {
+            dirty[numDirty++] = pt;
+            maxLSN = pt->pageLSN > maxLSN ? pt->pageLSN : maxLSN;
+        }
+        else
+        {
+            pthread_rwlock_unlock(&pt->latch);
+            releasePin(pt);
+        }
     }
-    
-    
-    BufferClass *bf = getBMmgmt(bm);;
-    BMFrame *pt = bf->head;
-    while (pt!=bf->head)
+
+    RC writeValue = RC_OK;
+
+    if (numDirty > 0)
     {
-        if (pt->isdirty==true)
+        // one log flush covers every frame of the pool
+        if (logBeforeWrite(bf, maxLSN) != RC_OK)
+            writeValue = RC_WRITE_FAILED;
+
+        qsort(dirty, numDirty, sizeof(BMFrame *), compareFramePages);
+
+        int start = 0;
+        while (start < numDirty && writeValue == RC_OK)
         {
-            RC writeValue = writeBlock(pt->currpage, &fHandle, pt->data);
+            int end = start + 1;
+            pages[0] = dirty[start]->data;
+            while (end < numDirty && dirty[end]->currpage == dirty[end - 1]->currpage + 1)
+            {
+                pages[end - start] = dirty[end]->data;
+                end++;
+            }
 
-            if (writeValue!=RC_OK){
-                return writeValue;
+            lockFile(bf, dirty[end - 1]->currpage);
+            writeValue = writeBlocks(dirty[start]->currpage, end - start, &bf->fHandle, pages);
+            pthread_rwlock_unlock(&bf->fileLock);
+            if (writeValue == RC_OK)
+            {
+                for (int i = start; i < end; i++)
+                    __atomic_store_n(&dirty[i]->isdirty, false, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&bf->numWrite, end - start, __ATOMIC_RELAXED);
+                __atomic_store_n(&bf->unsynced, true, __ATOMIC_RELAXED);
             }
-            bf->numWrite++;
-            pt->isdirty = false;
+            start = end;
         }
-        pt = pt->next;
-    };
-    
-    closePageFile(&fHandle);
+    }
 
-    return RC_OK;
+    for (int i = 0; i < numDirty; i++)
+    {
+        pthread_rwlock_unlock(&dirty[i]->latch);
+        releasePin(dirty[i]);
+    }
+
+    // no other latch is held now, so waiting for one cannot close a cycle
+    for (int i = 0; i < numBusy; i++)
+    {
+        BMFrame *pt = busy[i];
+
+        pthread_rwlock_rdlock(&pt->latch);
+        if (writeValue == RC_OK && __atomic_load_n(&pt->isdirty, __ATOMIC_ACQUIRE))
+            writeValue = poolWrite(bf, pt);
+        pthread_rwlock_unlock(&pt->latch);
+        releasePin(pt);
+    }
+
+    // evictions and forcePage may have written pages the durability policy still has to cover
+    if (writeValue == RC_OK && __atomic_load_n(&bf->unsynced, __ATOMIC_RELAXED))
+    {
+        // the sync may rewrite the header, nothing else may use the handle meanwhile
+        pthread_rwlock_wrlock(&bf->fileLock);
+        writeValue = syncPageFile(&bf->fHandle);
+        pthread_rwlock_unlock(&bf->fileLock);
+        __atomic_store_n(&bf->unsynced, writeValue != RC_OK, __ATOMIC_RELAXED);
+    }
+
+    free(dirty);
+    free(busy);
+    free(pages);
+
+    return writeValue;
 }
 
 // Buffer  Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page)
 {
     BufferClass *bf = getBMmgmt(bm);;
-    BMFrame *pt = bf->head;
+    BMFrame *pt = findFrame(bf, page->pageNum);
     
-    do{
-         pt=pt->next;
-        if (pt==bf->head)
-            return RC_READ_NON_EXISTING_PAGE;
-    }while (pt->currpage!=page->pageNum);
+    if (pt == NULL)
+        return RC_READ_NON_EXISTING_PAGE;
     
-    pt->isdirty = true;
+    __atomic_store_n(&pt->isdirty, true, __ATOMIC_RELEASE);
     return RC_OK;
 }
 
@@ -388,24 +1908,18 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page)
 
 {
     BufferClass *bf = getBMmgmt(bm);;
-    BMFrame *pt = bf->head;
-    
-    do{
-        pt=pt->next;
-        if (pt==bf->head)
-            return RC_READ_NON_EXISTING_PAGE;
-    }
-    while (pt->currpage!=page->pageNum);
+    BMFrame *pt = findFrame(bf, page->pageNum);
     
-    if (pt->fixCount == 0)
-        pt->refbit = false;
+    if (pt == NULL)
+        return RC_READ_NON_EXISTING_PAGE;
 
-    if (pt->fixCount > 0)
+    // the count only falls here, so a failed exchange means another unpin got in first
+    int count = pinCount(pt);
+    do
     {
-        pt->fixCount--;        
-    }
-    else
-        return RC_READ_NON_EXISTING_PAGE;
+        if (count == 0)
+            return RC_READ_NON_EXISTING_PAGE;
+    } while (!__atomic_compare_exchange_n(&pt->fixCount, &count, count - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
 
     return RC_OK;
 }
@@ -414,48 +1928,149 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page)
 {
     //current frame2file
     BufferClass *bf = getBMmgmt(bm);;
-    SM_FileHandle fHandle;
-    if(openPageFile(bm->pageFile, &fHandle) !=RC_OK) return RC_FILE_NOT_FOUND ;
 
-    
-    if(writeBlock(page->pageNum, &fHandle, page->data) !=RC_OK)
-    {
-        closePageFile(&fHandle);
+    BMFrame *pt = findFrame(bf, page->pageNum);
+
+    if (pt != NULL && logBeforeWrite(bf, pt->pageLSN) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    lockFile(bf, page->pageNum);
+    RC writeValue = writeBlock(page->pageNum, &bf->fHandle, page->data);
+    pthread_rwlock_unlock(&bf->fileLock);
+
+    if (writeValue != RC_OK)
         return RC_FILE_NOT_FOUND;
-    }
     
-    bf->numWrite = bf->numWrite + 1;
-    closePageFile(&fHandle);
+    __atomic_add_fetch(&bf->numWrite, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&bf->unsynced, true, __ATOMIC_RELAXED);
     return RC_OK;
 }
 
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,  const PageNumber pageNum)
 {
-    if (pageNum>=0){
+    return pinPageHinted(bm, page, pageNum, BM_ACCESS_RANDOM);
+}
+
+RC pinPageHinted (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum,
+                  BM_AccessPattern pattern)
+{
+    if (pageNum < 0)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    BufferClass *bf = getBMmgmt(bm);
+    BMFrame *pt = NULL;
+
+    while (pt == NULL)
+    {
+        pt = pinResident(bf, pageNum);
+        if (pt == NULL)
+        {
+            RC loadValue = loadPage(bf, bm->strategy, pageNum, pattern, false, &pt);
+            if (loadValue != RC_OK)
+                return loadValue;
+            continue;
+        }
+
+        // the prefetch load already counted as the first reference of a prefetched page,
+        // and sequential pins never count
+        bool prefetched = __atomic_load_n(&pt->prefetched, __ATOMIC_RELAXED) &&
+                          __atomic_exchange_n(&pt->prefetched, 0, __ATOMIC_RELAXED);
+        if (pattern != BM_ACCESS_SEQUENTIAL)
+            strategyHit(bf, bm->strategy, pt, !prefetched);
+
+        // the page is still being read, the loader holds the frame latch until it is in
+        if (__atomic_load_n(&pt->loading, __ATOMIC_ACQUIRE))
+        {
+            pthread_rwlock_rdlock(&pt->latch);
+            pthread_rwlock_unlock(&pt->latch);
+        }
+
+        if (pt->currpage != pageNum)
+        {
+            releasePin(pt);
+            pt = NULL;
+        }
+    }
+
+    page->pageNum = pageNum;
+    page->data = pt->data;
+
+    return RC_OK;
+}
+
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber *pageNums, int n)
+{
+    return prefetchPagesHinted(bm, pageNums, n, BM_ACCESS_RANDOM);
+}
 
-     if(bm->strategy == RS_CLOCK){
-        return clock_buffer(bm,page,pageNum);
-     }
-     else if(bm->strategy == RS_LRU_K){
-        return lruk_buffer(bm,page,pageNum);
-     }
-     else if(bm->strategy == RS_LRU){
-        return lru_buffer(bm,page,pageNum);
-     }  
-    else if(bm->strategy == RS_FIFO){
-        return fifo_buffer(bm,page,pageNum,false);
-     }      
+RC prefetchPagesHinted (BM_BufferPool *const bm, const PageNumber *pageNums, int n, BM_AccessPattern pattern)
+{
+    if (bm == NULL || bm->mgmtData == NULL)
+        return RC_BUFFER_POOL_NOT_INITIALIZED;
+    if (n < 0 || (n > 0 && pageNums == NULL))
+        return RC_INVALID_ARGUMENT;
+
+    BufferClass *bf = getBMmgmt(bm);
+
+    // a prefetch must not grow the file the way pinning a page past its end does
+    pthread_rwlock_rdlock(&bf->fileLock);
+    PageNumber totalNumPages = bf->fHandle.totalNumPages;
+    pthread_rwlock_unlock(&bf->fileLock);
 
-     return RC_IM_KEY_NOT_FOUND;
-                     
+    pthread_mutex_lock(&bf->prefetchLock);
+    RC result = RC_OK;
+    if (!bf->prefetcherRunning)
+    {
+        if (bf->prefetchQueue == NULL)
+            bf->prefetchQueue = malloc(bf->numFrames * sizeof(PrefetchRequest));
+        bf->prefetchStop = false;
+        if (bf->prefetchQueue == NULL || pthread_create(&bf->prefetcher, NULL, poolPrefetcher, bm) != 0)
+            result = RC_MEMORY_ALLOCATION_FAILED;
+        bf->prefetcherRunning = result == RC_OK;
+    }
+
+    for (int i = 0; i < n && result == RC_OK && bf->prefetchCount < bf->numFrames; i++)
+    {
+        if (pageNums[i] < 0 || pageNums[i] >= totalNumPages)
+            continue;
+        PrefetchRequest *request = &bf->prefetchQueue[(bf->prefetchFirst + bf->prefetchCount++) % bf->numFrames];
+        request->page = pageNums[i];
+        request->pattern = pattern;
     }
+    pthread_cond_signal(&bf->prefetchWake);
+    pthread_mutex_unlock(&bf->prefetchLock);
 
-    return RC_IM_KEY_NOT_FOUND;
+    return result;
+}
+
+RC latchPage (BM_BufferPool *const bm, BM_PageHandle *const page, bool exclusive)
+{
+    BMFrame *pt = findFrame(getBMmgmt(bm), page->pageNum);
+
+    if (pt == NULL || pinCount(pt) == 0)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    if (exclusive)
+        pthread_rwlock_wrlock(&pt->latch);
+    else
+        pthread_rwlock_rdlock(&pt->latch);
+    return RC_OK;
+}
+
+RC unlatchPage (BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+    BMFrame *pt = findFrame(getBMmgmt(bm), page->pageNum);
+
+    if (pt == NULL)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    pthread_rwlock_unlock(&pt->latch);
+    return RC_OK;
 }
 
 PageNumber *getFrameContents (BM_BufferPool *const bm)
 {
-    PageNumber *arr = malloc(sizeof(int));
+    PageNumber *arr = malloc(bm->numPages * sizeof(PageNumber));
     BufferClass *bf = getBMmgmt(bm);
     statlist *sptr = bf->stathead;
     int count = 0 ;
@@ -463,7 +2078,7 @@ PageNumber *getFrameContents (BM_BufferPool *const bm)
     while (count<bm->numPages)
     {
 
-        int curr = sptr->fpt->currpage;
+        PageNumber curr = sptr->fpt->currpage;
         arr[count++]=curr;
         sptr=sptr->next;
     }
@@ -473,18 +2088,13 @@ PageNumber *getFrameContents (BM_BufferPool *const bm)
 
 bool *getDirtyFlags (BM_BufferPool *const bm)
 {
-    bool *flag = malloc(sizeof(bool)); 
+    bool *flag = malloc(bm->numPages * sizeof(bool));
     BufferClass *bf = getBMmgmt(bm);
     statlist *pntr = bf->stathead;
     int count=0;
     while (pntr!=NULL && count<bm->numPages)
     {
-        bool searchdirty = pntr->fpt->isdirty;
-        if (searchdirty)
-        { 
-            flag[count++]=1;
-        }
-
+        flag[count++] = __atomic_load_n(&pntr->fpt->isdirty, __ATOMIC_ACQUIRE);
         pntr=pntr->next;
     }
 
@@ -496,11 +2106,36 @@ int *getFixCounts (BM_BufferPool *const bm)
     BufferClass *bf = getBMmgmt(bm);
     statlist *spt = bf->stathead;
     int count = 0;
-    PageNumber *pg = malloc(sizeof(int)); 
-    while(count++<bm->numPages){
-    pg[count]=spt->fpt->fixCount;
+    int *pg = malloc(bm->numPages * sizeof(int));
+    while(count<bm->numPages){
+    pg[count++]=pinCount(spt->fpt);
         spt=spt->next;
     }
     return pg;
 }
 
+
+int getNumReadIO (BM_BufferPool *const bm)
+{
+    return __atomic_load_n(&getBMmgmt(bm)->numRead, __ATOMIC_RELAXED);
+}
+
+int getNumWriteIO (BM_BufferPool *const bm)
+{
+    return __atomic_load_n(&getBMmgmt(bm)->numWrite, __ATOMIC_RELAXED);
+}
+
+int getNumEvictionWrites (BM_BufferPool *const bm)
+{
+    return __atomic_load_n(&getBMmgmt(bm)->numEvictWrite, __ATOMIC_RELAXED);
+}
+
+int getNumPrefetchReads (BM_BufferPool *const bm)
+{
+    return __atomic_load_n(&getBMmgmt(bm)->numPrefetchRead, __ATOMIC_RELAXED);
+}
+
+int getNumPrefetchUnused (BM_BufferPool *const bm)
+{
+    return __atomic_load_n(&getBMmgmt(bm)->numPrefetchUnused, __ATOMIC_RELAXED);
+}
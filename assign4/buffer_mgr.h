@@ -7,19 +7,56 @@
 // Include bool DT
 #include "dt.h"
 
+// Write-ahead log handles and LSNs
+#include "wal_mgr.h"
+
 // Replacement Strategies
 typedef enum ReplacementStrategy {
 	RS_FIFO = 0,
 	RS_LRU = 1,
 	RS_CLOCK = 2,
 	RS_LFU = 3,
-	RS_LRU_K = 4
+	RS_LRU_K = 4,
+	RS_ARC = 5
 } ReplacementStrategy;
 
-// Data Types and Structures
-typedef int PageNumber;
+// Access pattern hints for pinPageHinted and prefetchPagesHinted
+typedef enum BM_AccessPattern {
+	BM_ACCESS_RANDOM = 0,
+	BM_ACCESS_SEQUENTIAL = 1
+} BM_AccessPattern;
+
+// Data Types and Structures (PageNumber comes from dberror.h)
 #define NO_PAGE -1
 
+// stratData for RS_LRU_K, periods count pinPage calls; NULL = K of 2, no
+// correlated reference period and histories retained for four pool sizes of pins
+typedef struct BM_LRUKParams {
+	int k; // references remembered per page, the victim has the oldest K-th newest one
+	int correlatedPeriod; // a re-pin within this many pins counts as the same reference
+	int retainedPeriod; // history of an evicted page is kept this long, 0 = not kept
+} BM_LRUKParams;
+
+// stratData for RS_LFU; NULL = no aging
+typedef struct BM_LFUParams {
+	int agingPeriod; // every this many pinPage calls all reference counts are halved, 0 = never
+} BM_LFUParams;
+
+// settings for startPoolWriter; NULL = keep the next quarter of the pool to be
+// evicted clean, writing at most 64 pages every 10 ms
+typedef struct BM_WriterParams {
+	int cleanPercent; // share of the pool, in eviction order, the writer keeps clean
+	int maxPagesPerRound; // rate limit: pages written per round, 0 = no limit
+	int intervalMillis; // pause between rounds
+} BM_WriterParams;
+
+// settings for initBufferPoolWithParams; NULL (and initBufferPool) = buffered I/O.
+// There is no mapped mode, frames always hold copies (see openPageFileMapped)
+typedef struct BM_PoolParams {
+	bool directIO; // open the page file with openPageFileDirect, bypassing the OS page cache
+	SM_Tablespace *space; // non-NULL: pageFileName is a relation in this open tablespace (directIO is ignored)
+} BM_PoolParams;
+
 typedef struct BM_BufferPool {
 	char *pageFile;
 	int numPages;
@@ -44,8 +81,25 @@ typedef struct BM_PageHandle {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		const int numPages, ReplacementStrategy strategy,
 		void *stratData);
+RC initBufferPoolWithParams(BM_BufferPool *const bm, const char *const pageFileName,
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData, BM_PoolParams *params);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+int getPoolPageSize(BM_BufferPool *const bm); // bytes in each page handle's data
+bool isPoolDirectIO(BM_BufferPool *const bm); // false also where the file system refused O_DIRECT
+
+// Write-ahead logging: with a log set, logPageUpdate records the after-image of
+// a changed byte range and marks the page dirty; the pool never writes a frame
+// before the log is durable up to that frame's newest LSN
+RC setPoolLog(BM_BufferPool *const bm, WAL_Log *log);
+RC logPageUpdate(BM_BufferPool *const bm, BM_PageHandle *const page, int offset, int length, LSN *lsn);
+
+// Background writer: a thread per pool writing dirty unpinned pages that are
+// next in line for eviction, so misses find clean victims and do not wait
+// for a write; shutdownBufferPool stops it
+RC startPoolWriter(BM_BufferPool *const bm, BM_WriterParams *params);
+RC stopPoolWriter(BM_BufferPool *const bm);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
@@ -54,11 +108,36 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
 
+// pinPage with an access pattern hint (pinPage is BM_ACCESS_RANDOM): sequential
+// misses are read into a small ring of frames that the next sequential misses
+// recycle, and sequential hits do not count as references, so a large scan
+// does not displace the pool's working set. A random pin of a ring page
+// returns it to the shared pool.
+RC pinPageHinted (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const PageNumber pageNum, BM_AccessPattern pattern);
+
+// Prefetching: queues pages to be read into unpinned frames by a background
+// thread, so later pins are hits; pages already resident or past the end of
+// the file are skipped, and requests beyond a pool's worth of queued pages
+// are dropped. The read stands for the page's first reference.
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber *pageNums, int n);
+RC prefetchPagesHinted (BM_BufferPool *const bm, const PageNumber *pageNums, int n, BM_AccessPattern pattern);
+
+// Page latches for pools shared between threads: the page must be pinned, a
+// shared latch keeps the data from changing, an exclusive one is held while
+// changing it (markDirty before unlatching). Pin counts, the page table and
+// the replacement state are thread safe without them.
+RC latchPage (BM_BufferPool *const bm, BM_PageHandle *const page, bool exclusive);
+RC unlatchPage (BM_BufferPool *const bm, BM_PageHandle *const page);
+
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
 bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+int getNumEvictionWrites (BM_BufferPool *const bm); // dirty victims pinPage had to write itself
+int getNumPrefetchReads (BM_BufferPool *const bm); // pages read by prefetchPages, also in getNumReadIO
+int getNumPrefetchUnused (BM_BufferPool *const bm); // prefetched pages evicted before they were pinned
 
 #endif
@@ -25,7 +25,7 @@ printPoolContent (BM_BufferPool *const bm)
 	printf(" %i}: ", bm->numPages);
 
 	for (i = 0; i < bm->numPages; i++)
-		printf("%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+		printf("%s[%lld%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
 	printf("\n");
 }
 
@@ -45,35 +45,38 @@ sprintPoolContent (BM_BufferPool *const bm)
 	fixCount = getFixCounts(bm);
 
 	for (i = 0; i < bm->numPages; i++)
-		pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+		pos += sprintf(message + pos, "%s[%lld%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
 
 	return message;
 }
 
 
+// pages are as large as the pool's file says, not PAGE_SIZE
 void
-printPageContent (BM_PageHandle *const page)
+printPageContent (BM_BufferPool *const bm, BM_PageHandle *const page)
 {
 	int i;
+	int pageSize = getPoolPageSize(bm);
 
-	printf("[Page %i]\n", page->pageNum);
+	printf("[Page %lld]\n", page->pageNum);
 
-	for (i = 1; i <= PAGE_SIZE; i++)
-		printf("%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+	for (i = 1; i <= pageSize; i++)
+		printf("%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
 }
 
 char *
-sprintPageContent (BM_PageHandle *const page)
+sprintPageContent (BM_BufferPool *const bm, BM_PageHandle *const page)
 {
 	int i;
 	char *message;
 	int pos = 0;
+	int pageSize = getPoolPageSize(bm);
 
-	message = (char *) malloc(30 + (2 * PAGE_SIZE) + (PAGE_SIZE % 64) + (PAGE_SIZE % 8));
-	pos += sprintf(message + pos, "[Page %i]\n", page->pageNum);
+	message = (char *) malloc(30 + (2 * pageSize) + (pageSize / 64) + (pageSize / 8));
+	pos += sprintf(message + pos, "[Page %lld]\n", page->pageNum);
 
-	for (i = 1; i <= PAGE_SIZE; i++)
-		pos += sprintf(message + pos, "%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+	for (i = 1; i <= pageSize; i++)
+		pos += sprintf(message + pos, "%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
 
 	return message;
 }
@@ -98,6 +101,9 @@ printStrat (BM_BufferPool *const bm)
 	case RS_LRU_K:
 		printf("LRU-K");
 		break;
+	case RS_ARC:
+		printf("ARC");
+		break;
 	default:
 		printf("%i", bm->strategy);
 		break;
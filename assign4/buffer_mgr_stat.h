@@ -5,8 +5,8 @@
 
 // debug functions
 void printPoolContent (BM_BufferPool *const bm);
-void printPageContent (BM_PageHandle *const page);
+void printPageContent (BM_BufferPool *const bm, BM_PageHandle *const page);
 char *sprintPoolContent (BM_BufferPool *const bm);
-char *sprintPageContent (BM_PageHandle *const page);
+char *sprintPageContent (BM_BufferPool *const bm, BM_PageHandle *const page);
 
 #endif
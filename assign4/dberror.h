@@ -6,6 +6,9 @@
 /* module wide constants */
 #define PAGE_SIZE 4096
 
+/* page numbers are 64 bit so page files are not capped at 2^31 bytes */
+typedef long long PageNumber;
+
 /* return code definitions */
 typedef int RC;
 
@@ -54,6 +57,16 @@ typedef int RC;
 #define RC_INVALID_RECORD_SIZE 703 // Added a new definition for invalid record size
 #define RC_CONTINUE 704 // Added a new definition for continuing parsing records
 #define RC_FILE_DELETION_FAILED 801
+#define RC_ASYNC_NOT_INIT 802     // Added a new definition for async I/O used before initAsyncIO
+#define RC_ASYNC_QUEUE_FULL 803   // Added a new definition for a full async submission queue
+#define RC_INVALID_PAGE_FILE 804  // Added a new definition for a page file without a valid header
+#define RC_INVALID_LOG_FILE 805   // Added a new definition for a log file without a valid header
+#define RC_LOG_FAILED 806         // Added a new definition for a log that could not be made durable
+#define RC_CORRUPT_PAGE 807       // Added a new definition for a compressed page that does not decompress
+#define RC_RELATION_NOT_FOUND 808 // Added a new definition for a relation missing from its tablespace
+#define RC_RELATION_EXISTS 809    // Added a new definition for a relation name already in use
+#define RC_RELATION_IN_USE 810    // Added a new definition for a relation that still has open handles
+#define RC_WRITER_RUNNING 811     // Added a new definition for a background writer already running on the pool
 
 // Added new definition for B-Tree
 #define RC_ORDER_TOO_HIGH_FOR_PAGE 7001
@@ -0,0 +1,163 @@
+#include <string.h>
+#include <stdint.h>
+#include "lz_codec.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+static unsigned hashFour(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// a nibble of 15 continues in bytes of 255 ended by one below 255
+static unsigned char *putLength(unsigned char *op, unsigned char *oend, int length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        if (op >= oend)
+            return NULL;
+        *op++ = 255;
+    }
+
+    if (op >= oend)
+        return NULL;
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+static unsigned char *putSequence(unsigned char *op, unsigned char *oend, const unsigned char *literals,
+                                  int numLiterals, int offset, int matchLength)
+{
+    int matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+
+    if (op >= oend)
+        return NULL;
+    *op++ = (unsigned char)((numLiterals < 15 ? numLiterals : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+
+    if (numLiterals >= 15 && (op = putLength(op, oend, numLiterals - 15)) == NULL)
+        return NULL;
+
+    if (oend - op < numLiterals)
+        return NULL;
+    memcpy(op, literals, numLiterals);
+    op += numLiterals;
+
+    if (matchLength == 0)
+        return op;
+
+    if (oend - op < 2)
+        return NULL;
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+
+    if (matchCode >= 15)
+        return putLength(op, oend, matchCode - 15);
+
+    return op;
+}
+
+int lzCompress(const char *source, int sourceLen, char *dest, int destCap)
+{
+    const unsigned char *src = (const unsigned char *)source;
+    const unsigned char *ip = src, *anchor = src, *end = src + sourceLen;
+    unsigned char *op = (unsigned char *)dest, *oend = op + destCap;
+    int table[1 << LZ_HASH_BITS];
+
+    memset(table, -1, sizeof(table));
+
+    // greedy parse: take the longest extension of the last 4-byte match with the same hash
+    while (end - ip >= LZ_MIN_MATCH)
+    {
+        unsigned h = hashFour(ip);
+        int candidate = table[h];
+
+        table[h] = (int)(ip - src);
+
+        if (candidate < 0 || ip - src - candidate > LZ_MAX_OFFSET || memcmp(src + candidate, ip, LZ_MIN_MATCH) != 0)
+        {
+            ip++;
+            continue;
+        }
+
+        const unsigned char *match = src + candidate;
+
+        int length = LZ_MIN_MATCH;
+        while (ip + length < end && match[length] == ip[length])
+            length++;
+
+        op = putSequence(op, oend, anchor, (int)(ip - anchor), (int)(ip - match), length);
+        if (op == NULL)
+            return 0;
+
+        ip += length;
+        anchor = ip;
+    }
+
+    op = putSequence(op, oend, anchor, (int)(end - anchor), 0, 0);
+    return op == NULL ? 0 : (int)(op - (unsigned char *)dest);
+}
+
+static int getLength(const unsigned char **ip, const unsigned char *iend, int length)
+{
+    unsigned char more;
+
+    do
+    {
+        if (*ip >= iend)
+            return -1;
+        more = *(*ip)++;
+        length += more;
+    } while (more == 255 && length < (1 << 24));
+
+    return more == 255 ? -1 : length;
+}
+
+int lzDecompress(const char *source, int sourceLen, char *dest, int destCap)
+{
+    const unsigned char *ip = (const unsigned char *)source, *iend = ip + sourceLen;
+    unsigned char *op = (unsigned char *)dest, *oend = op + destCap;
+
+    while (ip < iend)
+    {
+        int token = *ip++;
+        int numLiterals = token >> 4;
+
+        if (numLiterals == 15 && (numLiterals = getLength(&ip, iend, 15)) < 0)
+            return -1;
+        if (iend - ip < numLiterals || oend - op < numLiterals)
+            return -1;
+
+        memcpy(op, ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        int offset = ip[0] | ip[1] << 8;
+        ip += 2;
+
+        int length = token & 15;
+        if (length == 15 && (length = getLength(&ip, iend, 15)) < 0)
+            return -1;
+        length += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > op - (unsigned char *)dest || oend - op < length)
+            return -1;
+
+        // the match may overlap the bytes it produces, so copy forward byte by byte
+        const unsigned char *match = op - offset;
+        for (int i = 0; i < length; i++)
+            op[i] = match[i];
+        op += length;
+    }
+
+    return (int)(op - (unsigned char *)dest);
+}
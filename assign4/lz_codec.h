@@ -0,0 +1,17 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+/* small LZ77 block codec for page images: a sequence is a token byte
+ * (literal count << 4 | match length - 4), extra length bytes for either
+ * nibble at 15, the literals and a two byte little-endian match offset.
+ * The last sequence has literals only. Blocks are at most 64 KB. */
+
+/* compress sourceLen bytes into dest; returns the compressed length, or 0
+ * if the result would not fit in destCap bytes */
+extern int lzCompress (const char *source, int sourceLen, char *dest, int destCap);
+
+/* returns the decompressed length, or -1 if source is not a valid block
+ * or decompresses to more than destCap bytes */
+extern int lzDecompress (const char *source, int sourceLen, char *dest, int destCap);
+
+#endif
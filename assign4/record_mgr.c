@@ -21,6 +21,10 @@ typedef struct Create_RecordManager
 
 Create_RecordManager *recordManager; // Initialization of above Record Manager object
 
+static SM_Tablespace *tableSpace; // Open tablespace holding every table as a relation, NULL for one page file per table
+
+#define SCAN_PREFETCH_DEPTH 4 // Pages a scan asks the buffer pool to read ahead of it
+
 // Auxilary function to check whether record manager is initialized or not
 int checkRecordInitFlag()
 {
@@ -35,6 +39,7 @@ RC initRecordManager(void *mgmtData)
 	{
 		initStorageManager(); // Initialize the storage manager
 	}
+	tableSpace = (SM_Tablespace *)mgmtData; // An open tablespace, or NULL
 	return RC_OK; // Return OK
 }
 // A schema object that hold stat values for each page file
@@ -136,6 +141,7 @@ RC shutdownRecordManager()
 
 	recordManager = NULL;
 	free(recordManager);
+	tableSpace = NULL; // The caller closes its tablespace
 	return RC_OK;
 }
 
@@ -145,24 +151,7 @@ extern RC createTable(char *name, Schema *schema)
 	recordManager = (Create_RecordManager *)calloc(1, sizeof(Create_RecordManager)); // Allocate memory and initialize record manager
 
 	// Check if record manager allocation was successful
-	if (recordManager != NULL)
-	{
-		BM_BufferPool *bufferPool = &(recordManager->bufferManagerPool); // Get the buffer pool from record manager
-
-		// Initialize the buffer pool
-		if (initBufferPool(bufferPool, name, tableIndex, RS_CLOCK, NULL) == RC_OK)
-		{
-			// Buffer pool initialization successful
-			printf("Buffer initialisation successfull");
-		}
-		else
-		{
-			// Buffer pool initialization failed
-			free(recordManager);	   // Free memory allocated for record manager
-			return RC_BUFFER_NOT_INIT; // Return error code
-		}
-	}
-	else
+	if (recordManager == NULL)
 	{
 		// Memory allocation for record manager failed
 		return RC_ERROR; // Return error code
@@ -209,14 +198,36 @@ extern RC createTable(char *name, Schema *schema)
 
 	SM_FileHandle fileHandle;
 
-	// Throw error if page file does not open or page file with given name cannot be created.
-	if (createPageFile(name) != RC_OK || RC_OK != openPageFile(name, &fileHandle))
+	// Throw error if page file (or relation) does not open or with given name cannot be created.
+	if (tableSpace != NULL)
+	{
+		if (createRelation(tableSpace, name) != RC_OK || RC_OK != openRelation(tableSpace, name, &fileHandle))
+			return RC_FILE_NOT_FOUND;
+	}
+	else if (createPageFile(name) != RC_OK || RC_OK != openPageFile(name, &fileHandle))
 		return RC_FILE_NOT_FOUND;
 
 	int writeCode = writeBlock(0, &fileHandle, data);
 	if (writeCode == RC_OK)
-		return closePageFile(&fileHandle);
-	return writeCode;
+		writeCode = closePageFile(&fileHandle);
+	if (writeCode != RC_OK)
+		return writeCode;
+
+	// The buffer pool keeps the page file open, so it is initialised once the file exists
+	BM_BufferPool *bufferPool = &(recordManager->bufferManagerPool); // Get the buffer pool from record manager
+	BM_PoolParams poolParams = {.space = tableSpace};				 // Open the table where it was created
+
+	if (initBufferPoolWithParams(bufferPool, name, tableIndex, RS_CLOCK, NULL, &poolParams) == RC_OK)
+	{
+		// Buffer pool initialization successful
+		printf("Buffer initialisation successfull");
+		return RC_OK;
+	}
+
+	// Buffer pool initialization failed
+	free(recordManager);	   // Free memory allocated for record manager
+	recordManager = NULL;
+	return RC_BUFFER_NOT_INIT; // Return error code
 }
 
 // Function to open a table with the given name and relation
@@ -281,8 +292,11 @@ extern RC deleteTable(char *name)
 	// Check if the table name is not NULL before deleting
 	if (name != NULL)
 	{
-		// Call destroyPageFile function and pass name into it
-		destroyPageFile(name);
+		// Call dropRelation or destroyPageFile function and pass name into it
+		if (tableSpace != NULL)
+			dropRelation(tableSpace, name);
+		else
+			destroyPageFile(name);
 		return RC_OK;
 	}
 	else
@@ -337,9 +351,9 @@ extern int getRecordSize(Schema *schema)
 }
 
 // Function to find a free slot within a page
-int findFreeSlot(char *data, int recordSize)
+int findFreeSlot(char *data, int recordSize, int pageSize)
 {
-	int k = 0, slot_count = PAGE_SIZE / recordSize; // calculate slot count by dividing page sizes with each record size.
+	int k = 0, slot_count = pageSize / recordSize; // calculate slot count by dividing page sizes with each record size.
 
 	while (k < slot_count)
 	{
@@ -377,7 +391,7 @@ extern RC insertRecord(RM_TableData *rel, Record *record)
 		rid->page = insertIndex;																		// Set the page number to the current insert index
 		pinPage(&recordManager->bufferManagerPool, &recordManager->bufferManagerPageHandle, rid->page); // Pin the page
 		char *data = recordManager->bufferManagerPageHandle.data;										// Get a pointer to the page's data
-		rid->slot = findFreeSlot(data, recordSize);														// Find a free slot on the page
+		rid->slot = findFreeSlot(data, recordSize, getPoolPageSize(&recordManager->bufferManagerPool)); // Find a free slot on the page
 
 		if (rid->slot != -1)
 		{
@@ -580,10 +594,21 @@ extern RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond)
 
 	return RC_OK; // Success
 }
-// Auxilary function for pinning a page to the buffer pool
+// Auxilary function to let the buffer pool read the pages after the one a scan just entered
+void prefetchScanPages(BM_BufferPool *bm, int pageNum)
+{
+	PageNumber pageNums[SCAN_PREFETCH_DEPTH]; // The next pages of the table, pages past its end are skipped by the pool
+	for (int i = 0; i < SCAN_PREFETCH_DEPTH; i++)
+	{
+		pageNums[i] = pageNum + 1 + i;
+	}
+	prefetchPagesHinted(bm, pageNums, SCAN_PREFETCH_DEPTH, BM_ACCESS_SEQUENTIAL);
+}
+
+// Auxilary function for pinning a page of a scan to the buffer pool
 RC pinPageWrapper(BM_BufferPool *bm, BM_PageHandle *page, const int pageNum)
 {
-	return pinPage(bm, page, pageNum); // return the pinned page
+	return pinPageHinted(bm, page, pageNum, BM_ACCESS_SEQUENTIAL); // a sequential pin recycles a few frames instead of evicting the table's working set
 }
 
 // Auxilary function for unpinning a page from the buffer pool
@@ -670,7 +695,7 @@ extern RC next(RM_ScanHandle *scan, Record *record)
 	Create_RecordManager *RM_tableManager = (Create_RecordManager *)scan->rel->mgmtData;
 
 	int recordMgrSize = getRecordSize(scan->rel->schema);  // Get the size of each record based on the schema of the scan
-	int recordCountSlots = PAGE_SIZE / recordMgrSize;	   // Calculate the number of record slots per page
+	int recordCountSlots = getPoolPageSize(&RM_tableManager->bufferManagerPool) / recordMgrSize; // Calculate the number of record slots per page
 	int recordEntriesCount = RM_tableManager->totalTuples; // Get the total number of record entries in the table
 
 	// Check initial scan conditions
@@ -682,6 +707,10 @@ extern RC next(RM_ScanHandle *scan, Record *record)
 	for (int recordSearchCount = RM_scanManager->totalScans; recordSearchCount <= recordEntriesCount; ++recordSearchCount)
 	{
 		incrementRecordIDIfNeeded(RM_scanManager, recordSearchCount, recordCountSlots);
+		if (RM_scanManager->recID.slot == 0) // The scan entered a new page, so the following ones are read ahead
+		{
+			prefetchScanPages(&RM_tableManager->bufferManagerPool, RM_scanManager->recID.page);
+		}
 		pinPageAndCopyData(RM_scanManager, RM_tableManager, record, recordMgrSize);
 
 		// Evaluate the expression for the current record
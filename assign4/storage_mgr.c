@@ -1,282 +1,3485 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "storage_mgr.h"
+#include "lz_codec.h"
 
-FILE *pageFile;
+// on-disk header kept in the first SM_HEADER_SIZE bytes of every page file,
+// page n starts at SM_HEADER_SIZE + n * pageSize
+#define SM_HEADER_SIZE 4096
+#define SM_MAGIC "SMPGFILE"
+#define SM_VERSION 2
 
-extern void initStorageManager(void)
+typedef struct SM_FileHeader
 {
-}
+    char magic[8];
+    int version;
+    PageNumber numPages; // logical size, what totalNumPages reports
+    PageNumber allocatedPages; // pages reserved on disk, numPages <= allocatedPages
+    PageNumber freePages; // pages marked in the free-page map
+    int holeRunPages; // punch a hole once this many neighbouring pages are free, 0 = never
+    PageNumber segmentPages; // pages per segment file, 0 = all pages in this one file
+    int pageSize; // bytes per page, 0 in files written before it was configurable = PAGE_SIZE
+    int durability; // SM_Durability of the file, kept across opens
+    int durabilityParam; // sync interval in ms or write-behind distance in pages
+    int compressed; // pages live in variable-size slots found through the page directory
+    PageNumber dataEnd; // compressed files: end of the slot area, new slots are appended here
+    PageNumber dirOffset; // compressed files: slot holding the page directory
+    PageNumber dirBytes;
+} SM_FileHeader;
+
+// the rest of the header page is a bitmap of freed pages, bit n set = page n is free
+#define SM_FREEMAP_OFFSET 256
+#define SM_FREEMAP_PAGES ((SM_HEADER_SIZE - SM_FREEMAP_OFFSET) * 8)
+
+_Static_assert(sizeof(SM_FileHeader) <= SM_FREEMAP_OFFSET, "header fields overlap the free-page map");
+
+// compressed files keep page n in dir[n].length bytes at dir[n].offset; a length
+// of 0 is a page of zeros, a length of pageSize a page stored as is
+typedef struct SM_PageSlot
+{
+    PageNumber offset;
+    int length;
+    int unused;
+} SM_PageSlot;
 
-RC createPageFile(char *fileName)
+// a run of bytes (compressed slots) or pages (tablespace extents)
+typedef struct SM_Range
 {
-    FILE *file = fopen(fileName, "w");
+    PageNumber offset;
+    PageNumber length;
+} SM_Range;
 
-    if (!file)
-    {
-        return RC_WRITE_FAILED;
-    }
+// slots are allocated in units of SM_SLOT_ALIGN bytes
+#define SM_SLOT_ALIGN 256
 
-    if (fwrite("\0", sizeof(char), PAGE_SIZE, file) < PAGE_SIZE)
-    {
-        fclose(file);
-        return RC_WRITE_FAILED;
-    }
+// retired slots are reclaimed by rewriting the directory once this many pile up
+#define SM_RETIRE_LIMIT 1024
 
-    fclose(file);
-    return RC_OK;
+// files grow in extents that double with the file, capped at SM_MAX_EXTENT pages
+#define SM_MIN_EXTENT 8
+#define SM_MAX_EXTENT 16384
+
+// bookkeeping kept in fHandle->mgmtInfo while a page file is open
+typedef struct SM_FileInfo
+{
+    int fd; // descriptor of the first (header) segment, all block I/O is positional
+    char *fileName; // copy of the base name, segment k > 0 is "fileName.k"
+    int *segments; // one descriptor per open segment file, segments[0] == fd
+    int numSegments;
+    int openFlags; // extra open(2) flags every segment is opened with
+    int pageSize; // the header's page size, fixed for the life of the file
+
+    // sequential readahead into a per-handle staging cache, see readStaged
+    pthread_mutex_t raLock; // guards the readahead fields, threads reading one handle share them
+    char *raBuf; // raMaxPages pages, allocated on the first readahead
+    PageNumber raStart; // first page held in raBuf
+    int raCount; // pages of raBuf that are valid, 0 = empty
+    PageNumber raNext; // page a sequential reader would ask for next
+    int raRun; // consecutive reads that continued the previous one
+    int raWindow; // pages the next readahead fetches
+    int raMaxPages; // window cap, 0 = readahead off
+    int raAdvised; // POSIX_FADV_SEQUENTIAL is in effect
+
+    // durability policy state, see noteWrite
+    pthread_mutex_t syncLock; // held by the periodic syncer, and while segments are added
+    pthread_cond_t syncWake;
+    pthread_t syncer;
+    int syncerRunning;
+    int syncerStop;
+    int unsynced; // pages were written since the last sync
+    int writtenPages; // pages written since the last write-behind
+    PageNumber accessNext; // page after the last readBlocks/writeBlocks, tells sequential from random
+    SM_FileStats stats; // updated atomically, async workers and the periodic syncer add to it
+    char *map; // whole-file MAP_SHARED mapping in mapped mode, NULL otherwise
+    size_t mapLen; // reserved length of the mapping, may run past the end of the file
+    int direct; // descriptor opened with O_DIRECT, page buffers must be SM_IO_ALIGNMENT aligned
+    struct SM_AsyncQueue *async; // submission queue set up by initAsyncIO, NULL otherwise
+    SM_FileHeader *header; // SM_HEADER_SIZE aligned copy of the on-disk header
+    int headerDirty; // logical size changed since the header was last written
+
+    // compressed files, see writeCompressed
+    SM_PageSlot *dir; // page directory, dirCap entries
+    PageNumber dirCap;
+    int dirDirty; // dir differs from the copy in the file
+    SM_Range *gaps; // free space in the slot area, sorted by offset
+    int numGaps;
+    int gapCap;
+    SM_Range *retired; // replaced slots the directory in the file still points at
+    int numRetired;
+    int retiredCap;
+    char *zbuf; // pageSize bytes for compressed page images
+
+    // relation handles only: the pages live in a tablespace file, see openRelation
+    struct SM_TablespaceInfo *space;
+    struct SM_Relation *relation;
+} SM_FileInfo;
+
+static SM_FileHandle *spaceFile(SM_FileHandle *fHandle);
+static RC relationIO(SM_FileHandle *fHandle, PageNumber startPage, int count, SM_PageHandle pages[], int isWrite);
+static RC growRelation(SM_FileHandle *fHandle, PageNumber numPages);
+static RC closeRelation(SM_FileHandle *fHandle);
+static RC flushSpaceDirectory(struct SM_TablespaceInfo *ts);
+static PageNumber relationCapacity(struct SM_Relation *relation);
+static RC allocateRelationPage(SM_FileHandle *fHandle, PageNumber *pageNum);
+static RC freeRelationPage(SM_FileHandle *fHandle, PageNumber pageNum);
+static PageNumber relationFreePages(struct SM_Relation *relation);
+
+static const char zeroPage[SM_MAX_PAGE_SIZE] __attribute__((aligned(SM_IO_ALIGNMENT)));
+
+// a mapping reserves address space ahead of the file so growth rarely has to move it
+#define SM_MAP_MIN_RESERVE ((size_t)16 * 1024 * 1024)
+
+static SM_FileInfo *getFileInfo(SM_FileHandle *fHandle)
+{
+    return (SM_FileInfo *)fHandle->mgmtInfo;
 }
 
-RC openPageFile(char *fileName, SM_FileHandle *fHandle)
+static long long nowNanos(void)
 {
-    FILE *file = fopen(fileName, "r+");
+    struct timespec ts;
 
-    if (!file)
-    {
-        return RC_FILE_NOT_FOUND;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    fseek(file, 0, SEEK_END);
-    fHandle->totalNumPages = ftell(file) / PAGE_SIZE;
+static void addStat(long long *counter, long long amount)
+{
+    __atomic_add_fetch(counter, amount, __ATOMIC_RELAXED);
+}
 
-    fseek(file, 0, SEEK_SET);
-    fHandle->fileName = fileName;
-    fHandle->curPagePos = 0;
-    fHandle->mgmtInfo = file;
+static void countSync(SM_FileInfo *info, long long start)
+{
+    addStat(&info->stats.numSyncs, 1);
+    addStat(&info->stats.syncNanos, nowNanos() - start);
+}
 
-    return RC_OK;
+static void countTransfer(SM_FileInfo *info, int isWrite, long long bytes, int calls)
+{
+    addStat(isWrite ? &info->stats.bytesWritten : &info->stats.bytesRead, bytes);
+    addStat(isWrite ? &info->stats.numWriteCalls : &info->stats.numReadCalls, calls);
 }
 
-RC closePageFile(SM_FileHandle *fHandle)
+static void countAccess(SM_FileInfo *info, PageNumber startPage, int count)
 {
-    RC result = (fHandle == NULL || fHandle->mgmtInfo == NULL) ? RC_FILE_HANDLE_NOT_INIT : RC_OK;
+    PageNumber previous = __atomic_exchange_n(&info->accessNext, startPage + count, __ATOMIC_RELAXED);
 
-    FILE *file = (FILE *)fHandle->mgmtInfo;
+    addStat(startPage == previous ? &info->stats.numSequential : &info->stats.numRandom, 1);
+}
 
-    fHandle->fileName = result == RC_OK ? NULL : fHandle->fileName;
-    fHandle->curPagePos = result == RC_OK ? 0 : fHandle->curPagePos;
-    fHandle->totalNumPages = result == RC_OK ? 0 : fHandle->totalNumPages;
-    fHandle->mgmtInfo = result == RC_OK ? NULL : fHandle->mgmtInfo;
+static void countLatency(long long histogram[SM_LATENCY_BUCKETS], long long start)
+{
+    unsigned long long nanos = (unsigned long long)(nowNanos() - start) | 1;
+    int bucket = 63 - __builtin_clzll(nanos);
 
-    fclose(file);
+    addStat(&histogram[bucket < SM_LATENCY_BUCKETS ? bucket : SM_LATENCY_BUCKETS - 1], 1);
+}
 
-    return result;
+static off_t pageOffset(SM_FileInfo *info, PageNumber pageNum)
+{
+    return SM_HEADER_SIZE + (off_t)pageNum * info->pageSize;
 }
 
-RC destroyPageFile(char *fileName)
+// descriptor of the segment holding pageNum and the page's position inside it;
+// only the first segment carries the header, later ones start with their first page
+static int locatePage(SM_FileInfo *info, PageNumber pageNum, off_t *position)
 {
-    FILE *file = fopen(fileName, "r");
+    PageNumber perSegment = info->header->segmentPages;
 
-    if (!file)
+    if (perSegment <= 0)
     {
-        fclose(file);
-        return RC_FILE_NOT_FOUND;
+        *position = pageOffset(info, pageNum);
+        return info->fd;
     }
 
-    fclose(file);
+    PageNumber segment = pageNum / perSegment;
 
-    return (remove(fileName) == 0) ? RC_OK : RC_FILE_NOT_FOUND;
+    *position = (off_t)(pageNum % perSegment) * info->pageSize + (segment == 0 ? SM_HEADER_SIZE : 0);
+    return info->segments[segment];
 }
 
-RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+// how many of the count pages starting at pageNum share pageNum's segment
+static PageNumber segmentRun(SM_FileInfo *info, PageNumber pageNum, PageNumber count)
 {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL || pageNum > fHandle->totalNumPages || pageNum < 0)
-        return RC_READ_NON_EXISTING_PAGE;
+    PageNumber perSegment = info->header->segmentPages;
 
-    FILE *getFile = fopen(fHandle->fileName, "r");
+    if (perSegment <= 0)
+        return count;
 
-    long position = pageNum * PAGE_SIZE;
-    int seekPosition = fseek(getFile, position, SEEK_SET);
+    PageNumber left = perSegment - pageNum % perSegment;
+    return count < left ? count : left;
+}
 
-    if (seekPosition == 0)
-    {
-        if (fread(memPage, sizeof(char), PAGE_SIZE, getFile) < PAGE_SIZE)
-            return RC_FILE_NOT_FOUND;
-    }
+static int segmentsFor(SM_FileInfo *info, PageNumber numPages)
+{
+    PageNumber perSegment = info->header->segmentPages;
+
+    if (perSegment <= 0 || numPages <= perSegment)
+        return 1;
+
+    return (int)((numPages + perSegment - 1) / perSegment);
+}
+
+static char *segmentName(const char *fileName, int segment)
+{
+    size_t len = strlen(fileName) + 16;
+    char *name = malloc(len);
+
+    if (name == NULL)
+        return NULL;
+
+    if (segment == 0)
+        snprintf(name, len, "%s", fileName);
+    else
+        snprintf(name, len, "%s.%d", fileName, segment);
+
+    return name;
+}
+
+// open segment files until numSegments are open; with create set, missing
+// segments are created and stale ones left behind by an older file are emptied
+static RC openSegments(SM_FileInfo *info, int numSegments, int create)
+{
+    if (numSegments <= info->numSegments)
+        return RC_OK;
+
+    RC result = RC_OK;
+
+    // the periodic syncer walks the segment array, it must not see it move
+    pthread_mutex_lock(&info->syncLock);
+
+    int *segments = realloc(info->segments, numSegments * sizeof(int));
+    if (segments != NULL)
+        info->segments = segments;
     else
+        result = RC_MEMORY_ALLOCATION_FAILED;
+
+    while (result == RC_OK && info->numSegments < numSegments)
     {
-        return RC_READ_NON_EXISTING_PAGE;
+        char *name = segmentName(info->fileName, info->numSegments);
+        int fd = (name == NULL) ? -1 : open(name, O_RDWR | info->openFlags | (create ? O_CREAT | O_TRUNC : 0), 0644);
+
+        free(name);
+        if (fd < 0)
+            result = create ? RC_WRITE_FAILED : RC_FILE_NOT_FOUND;
+        else
+            info->segments[info->numSegments++] = fd;
     }
 
-    fHandle->curPagePos = ftell(getFile);
+    if (info->numSegments > 0)
+        info->fd = info->segments[0];
 
-    fclose(getFile);
-
-    return RC_OK;
+    pthread_mutex_unlock(&info->syncLock);
+    return result;
 }
 
-extern int getBlockPos(SM_FileHandle *fHandle)
+static RC closeSegments(SM_FileInfo *info)
 {
-    return fHandle->curPagePos;
+    RC result = RC_OK;
+
+    for (int i = 0; i < info->numSegments; i++)
+    {
+        if (close(info->segments[i]) != 0)
+            result = RC_WRITE_FAILED;
+    }
+
+    free(info->segments);
+    info->segments = NULL;
+    info->numSegments = 0;
+    return result;
 }
 
-RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+// pages backed by the open segment files, up to the first short segment
+static PageNumber pagesOnDisk(SM_FileInfo *info)
 {
-    if (readBlock(0, fHandle, memPage) == RC_OK)
-        return RC_OK;
+    PageNumber perSegment = info->header->segmentPages;
+    PageNumber pages = 0;
+    struct stat st;
 
-    return RC_READ_NON_EXISTING_PAGE;
+    for (int i = 0; i < info->numSegments && fstat(info->segments[i], &st) == 0; i++)
+    {
+        off_t base = (i == 0) ? SM_HEADER_SIZE : 0;
+        PageNumber here = (st.st_size > base) ? (st.st_size - base) / info->pageSize : 0;
+
+        if (perSegment <= 0)
+            return here;
+
+        pages += here < perSegment ? here : perSegment;
+        if (here < perSegment)
+            break;
+    }
+
+    return pages;
 }
 
-RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+// vectored variants: a short transfer leaves the iovec array partially consumed,
+// so skip the finished entries and trim the first unfinished one before retrying
+static void advanceIovec(struct iovec **iov, int *iovcnt, size_t done)
 {
-    if (readBlock(fHandle->curPagePos - 1, fHandle, memPage) == RC_OK)
-        return RC_OK;
+    while (*iovcnt > 0 && done >= (*iov)->iov_len)
+    {
+        done -= (*iov)->iov_len;
+        (*iov)++;
+        (*iovcnt)--;
+    }
 
-    return RC_READ_NON_EXISTING_PAGE;
+    if (*iovcnt > 0)
+    {
+        (*iov)->iov_base = (char *)(*iov)->iov_base + done;
+        (*iov)->iov_len -= done;
+    }
 }
 
-RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+static RC preadvFully(SM_FileInfo *info, int fd, struct iovec *iov, int iovcnt, off_t offset)
 {
-    if (readBlock(getBlockPos(fHandle), fHandle, memPage) == RC_OK)
+    // one call per request, retries after EINTR or a short transfer are not counted again
+    countTransfer(info, 0, 0, 1);
+
+    while (iovcnt > 0)
     {
-        return RC_OK;
+        ssize_t done = preadv(fd, iov, iovcnt, offset);
+
+        countTransfer(info, 0, done > 0 ? done : 0, 0);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return RC_READ_NON_EXISTING_PAGE;
+
+        offset += done;
+        advanceIovec(&iov, &iovcnt, done);
     }
 
-    return RC_READ_NON_EXISTING_PAGE;
+    return RC_OK;
 }
 
-RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+static RC pwritevFully(SM_FileInfo *info, int fd, struct iovec *iov, int iovcnt, off_t offset)
 {
-    if (readBlock(fHandle->curPagePos + 1, fHandle, memPage) == RC_OK)
+    // counted once, like preadvFully
+    countTransfer(info, 1, 0, 1);
+
+    while (iovcnt > 0)
     {
-        return RC_OK;
+        ssize_t done = pwritev(fd, iov, iovcnt, offset);
+
+        countTransfer(info, 1, done > 0 ? done : 0, 0);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return RC_WRITE_FAILED;
+
+        offset += done;
+        advanceIovec(&iov, &iovcnt, done);
     }
 
-    return RC_READ_NON_EXISTING_PAGE;
+    return RC_OK;
 }
 
-RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+// number of pages moved per preadv/pwritev call
+#define SM_MAX_IOVEC ((IOV_MAX) < 256 ? (IOV_MAX) : 256)
+
+static void fillIovec(struct iovec *iov, SM_PageHandle pages[], int count, int pageSize)
 {
-    if (readBlock(fHandle->totalNumPages - 1, fHandle, memPage) == RC_OK)
+    for (int i = 0; i < count; i++)
     {
-        return RC_OK;
+        iov[i].iov_base = pages[i];
+        iov[i].iov_len = pageSize;
     }
+}
 
-    return RC_READ_NON_EXISTING_PAGE;
+static int pagesAligned(SM_PageHandle pages[], int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if ((size_t)pages[i] % SM_IO_ALIGNMENT != 0)
+            return 0;
+    }
+
+    return 1;
 }
 
-RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+// O_DIRECT rejects unaligned buffers, stage such pages through one aligned page
+static RC transferBounced(SM_FileInfo *info, PageNumber startPage, int count, SM_PageHandle pages[], int isWrite)
 {
-    if (fHandle->mgmtInfo == NULL)
+    char *bounce;
+    struct iovec iov;
+    RC result = RC_OK;
+
+    if (posix_memalign((void **)&bounce, SM_IO_ALIGNMENT, info->pageSize) != 0)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    for (int i = 0; i < count && result == RC_OK; i++)
     {
-        return RC_FILE_HANDLE_NOT_INIT;
+        off_t position;
+        int fd = locatePage(info, startPage + i, &position);
+
+        iov.iov_base = bounce;
+        iov.iov_len = info->pageSize;
+
+        if (isWrite)
+        {
+            memcpy(bounce, pages[i], info->pageSize);
+            result = pwritevFully(info, fd, &iov, 1, position);
+        }
+        else
+        {
+            result = preadvFully(info, fd, &iov, 1, position);
+            if (result == RC_OK)
+                memcpy(pages[i], bounce, info->pageSize);
+        }
     }
 
-    if (pageNum < 0 || pageNum > fHandle->totalNumPages)
+    free(bounce);
+    return result;
+}
+
+static void disableDirectIO(SM_FileInfo *info)
+{
+    for (int i = 0; i < info->numSegments; i++)
     {
-        return RC_READ_NON_EXISTING_PAGE;
+        int flags = fcntl(info->segments[i], F_GETFL);
+
+        if (flags != -1)
+            fcntl(info->segments[i], F_SETFL, flags & ~O_DIRECT);
     }
 
-    FILE *getFilePage = fopen(fHandle->fileName, "r+");
+    info->openFlags &= ~O_DIRECT;
+    info->direct = 0;
+}
 
-    long pageoffset = (pageNum)*PAGE_SIZE;
+// moves a run of pages between the file and pages[] with preadv/pwritev
+static RC transferPages(SM_FileInfo *info, PageNumber startPage, int count, SM_PageHandle pages[], int isWrite)
+{
+    struct iovec iov[SM_MAX_IOVEC];
 
-    if (pageNum == 0)
+    for (int done = 0; done < count; )
     {
-        fseek(getFilePage, pageoffset, SEEK_SET);
-        int pg = 0;
-        while (pg < PAGE_SIZE)
+        int batch = (count - done < SM_MAX_IOVEC) ? count - done : SM_MAX_IOVEC;
+        off_t position;
+        int fd = locatePage(info, startPage + done, &position);
+        RC result;
+
+        // a vectored transfer never crosses into the next segment file
+        batch = (int)segmentRun(info, startPage + done, batch);
+
+        errno = 0;
+        if (info->direct && !pagesAligned(pages + done, batch))
+        {
+            result = transferBounced(info, startPage + done, batch, pages + done, isWrite);
+        }
+        else
         {
-            if (feof(getFilePage))
-                appendEmptyBlock(fHandle);
+            fillIovec(iov, pages + done, batch, info->pageSize);
+            result = isWrite ? pwritevFully(info, fd, iov, batch, position)
+                             : preadvFully(info, fd, iov, batch, position);
+        }
 
-            fputc(memPage[pg], getFilePage);
-            pg++;
+        // some filesystems accept O_DIRECT at open time and only refuse it here
+        if (result != RC_OK && info->direct && errno == EINVAL)
+        {
+            disableDirectIO(info);
+            continue;
         }
 
-        fHandle->curPagePos = ftell(getFilePage);
+        if (result != RC_OK)
+            return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
 
-        fclose(getFilePage);
-    }
-    else
-    {
-        fHandle->curPagePos = pageoffset;
-        fclose(getFilePage);
-        writeCurrentBlock(fHandle, memPage);
+        done += batch;
     }
 
-    fHandle->curPagePos = pageNum;
     return RC_OK;
 }
 
-RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+extern void initStorageManager(void)
 {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+}
+
+static SM_FileHeader *allocHeader(void)
+{
+    SM_FileHeader *header;
+
+    if (posix_memalign((void **)&header, SM_IO_ALIGNMENT, SM_HEADER_SIZE) != 0)
+        return NULL;
+
+    memset(header, 0, SM_HEADER_SIZE);
+    memcpy(header->magic, SM_MAGIC, sizeof(header->magic));
+    header->version = SM_VERSION;
+    return header;
+}
+
+static RC headerIO(SM_FileInfo *info, int isWrite)
+{
+    struct iovec iov;
+
+    for (;;)
     {
-        return RC_FILE_HANDLE_NOT_INIT;
+        iov.iov_base = info->header;
+        iov.iov_len = SM_HEADER_SIZE;
+
+        errno = 0;
+        RC result = isWrite ? pwritevFully(info, info->fd, &iov, 1, 0) : preadvFully(info, info->fd, &iov, 1, 0);
+
+        if (result != RC_OK && info->direct && errno == EINVAL)
+        {
+            disableDirectIO(info);
+            continue;
+        }
+
+        return result;
     }
+}
 
-    int currentBlockPos = getBlockPos(fHandle);
+static PageNumber slotBytes(PageNumber length)
+{
+    return (length + SM_SLOT_ALIGN - 1) / SM_SLOT_ALIGN * SM_SLOT_ALIGN;
+}
 
-    if (writeBlock(currentBlockPos, fHandle, memPage) == RC_WRITE_FAILED)
+static int insertRange(SM_Range **ranges, int *count, int *cap, int at, PageNumber offset, PageNumber length)
+{
+    if (*count == *cap)
     {
-        return RC_WRITE_FAILED;
+        int newCap = *cap > 0 ? *cap * 2 : 16;
+        SM_Range *grown = realloc(*ranges, newCap * sizeof(SM_Range));
+
+        if (grown == NULL)
+            return -1;
+        *ranges = grown;
+        *cap = newCap;
     }
 
-    fHandle->curPagePos++;
-    return RC_OK;
+    memmove(*ranges + at + 1, *ranges + at, (*count - at) * sizeof(SM_Range));
+    (*ranges)[at].offset = offset;
+    (*ranges)[at].length = length;
+    (*count)++;
+    return 0;
 }
 
-RC appendEmptyBlock(SM_FileHandle *fHandle)
+// add a range to a free list sorted by offset, merged with its neighbours; if the
+// list cannot grow the range is merely lost until the list is rebuilt
+static void releaseRange(SM_Range **ranges, int *count, int *cap, PageNumber offset, PageNumber length)
 {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+    SM_Range *free = *ranges;
+    int at = 0;
+
+    while (at < *count && free[at].offset < offset)
+        at++;
+
+    int joinsPrev = at > 0 && free[at - 1].offset + free[at - 1].length == offset;
+    int joinsNext = at < *count && offset + length == free[at].offset;
+
+    if (joinsPrev && joinsNext)
     {
-        return RC_FILE_HANDLE_NOT_INIT;
+        free[at - 1].length += length + free[at].length;
+        memmove(free + at, free + at + 1, (*count - at - 1) * sizeof(SM_Range));
+        (*count)--;
     }
+    else if (joinsPrev)
+        free[at - 1].length += length;
+    else if (joinsNext)
+    {
+        free[at].offset = offset;
+        free[at].length += length;
+    }
+    else if (length > 0)
+        insertRange(ranges, count, cap, at, offset, length);
+}
 
-    SM_PageHandle empty_page = (char *)calloc(PAGE_SIZE, sizeof(char));
-
-    if (empty_page == NULL)
+// first fit from a free list, -1 if no range is long enough
+static PageNumber takeRange(SM_Range *ranges, int *count, PageNumber length)
+{
+    for (int i = 0; i < *count; i++)
     {
-        return RC_WRITE_FAILED;
+        if (ranges[i].length < length)
+            continue;
+
+        PageNumber offset = ranges[i].offset;
+        ranges[i].offset += length;
+        ranges[i].length -= length;
+        if (ranges[i].length == 0)
+        {
+            memmove(ranges + i, ranges + i + 1, (*count - i - 1) * sizeof(SM_Range));
+            (*count)--;
+        }
+        return offset;
     }
 
-    if (fwrite(empty_page, sizeof(char), PAGE_SIZE, fHandle->mgmtInfo) != PAGE_SIZE)
+    return -1;
+}
+
+static void releaseSlot(SM_FileInfo *info, PageNumber offset, PageNumber length)
+{
+    releaseRange(&info->gaps, &info->numGaps, &info->gapCap, offset, length);
+}
+
+// first fit from the gaps, otherwise the slot area grows
+static PageNumber allocSlot(SM_FileInfo *info, PageNumber length)
+{
+    PageNumber offset = takeRange(info->gaps, &info->numGaps, length);
+
+    if (offset >= 0)
+        return offset;
+
+    offset = info->header->dataEnd;
+    info->header->dataEnd += length;
+    info->headerDirty = 1;
+    return offset;
+}
+
+static void retireSlot(SM_FileInfo *info, PageNumber offset, PageNumber length)
+{
+    if (length > 0)
+        insertRange(&info->retired, &info->numRetired, &info->retiredCap, info->numRetired, offset, length);
+}
+
+static RC reserveDirectory(SM_FileInfo *info, PageNumber pages)
+{
+    if (pages <= info->dirCap)
+        return RC_OK;
+
+    PageNumber cap = info->dirCap > 0 ? info->dirCap : SM_MIN_EXTENT;
+    while (cap < pages)
+        cap *= 2;
+
+    SM_PageSlot *dir = realloc(info->dir, cap * sizeof(SM_PageSlot));
+    if (dir == NULL)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    memset(dir + info->dirCap, 0, (cap - info->dirCap) * sizeof(SM_PageSlot));
+    info->dir = dir;
+    info->dirCap = cap;
+    return RC_OK;
+}
+
+// the directory goes to a fresh slot, the header switches over to it
+static RC flushDirectory(SM_FileInfo *info)
+{
+    SM_FileHeader *header = info->header;
+    PageNumber bytes = header->numPages * (PageNumber)sizeof(SM_PageSlot);
+    PageNumber offset = allocSlot(info, slotBytes(bytes));
+    struct iovec iov = {.iov_base = info->dir, .iov_len = bytes};
+
+    if (pwritevFully(info, info->fd, &iov, 1, offset) != RC_OK)
     {
-        free(empty_page);
+        releaseSlot(info, offset, slotBytes(bytes));
         return RC_WRITE_FAILED;
     }
 
-    fHandle->totalNumPages = fHandle->totalNumPages + 1;
-    fHandle->curPagePos = fHandle->totalNumPages - 1;
-
-    free(empty_page);
-    empty_page = NULL;
+    retireSlot(info, header->dirOffset, slotBytes(header->dirBytes));
+    header->dirOffset = offset;
+    header->dirBytes = bytes;
+    info->headerDirty = 1;
+    info->dirDirty = 0;
     return RC_OK;
 }
 
-RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle)
+static RC flushHeader(SM_FileInfo *info)
 {
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+    if (info->dirDirty && flushDirectory(info) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    if (!info->headerDirty)
+        return RC_OK;
+
+    RC result = headerIO(info, 1);
+    if (result == RC_OK)
     {
-        return RC_FILE_HANDLE_NOT_INIT;
+        info->headerDirty = 0;
+
+        // nothing in the file points at the retired slots any more
+        for (int i = 0; i < info->numRetired; i++)
+            releaseSlot(info, info->retired[i].offset, info->retired[i].length);
+        info->numRetired = 0;
     }
 
-    int currentPages = fHandle->totalNumPages;
+    return result;
+}
+
+static void freeCompression(SM_FileInfo *info)
+{
+    free(info->dir);
+    free(info->gaps);
+    free(info->retired);
+    free(info->zbuf);
+}
 
-    if (numberOfPages <= currentPages)
+// reserve disk blocks for pages [0, allocatedPages); the new range reads back as zeros
+static RC allocateExtent(SM_FileInfo *info, PageNumber allocatedPages)
+{
+    // compressed pages take a slot when they are written, growing only widens the directory
+    if (info->header->compressed)
     {
+        if (reserveDirectory(info, allocatedPages) != RC_OK)
+            return RC_WRITE_FAILED;
+
+        info->header->allocatedPages = allocatedPages;
+        info->headerDirty = 1;
         return RC_OK;
     }
 
-    if (fHandle->mgmtInfo != NULL)
+    if (openSegments(info, segmentsFor(info, allocatedPages), 1) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    for (PageNumber page = info->header->allocatedPages; page < allocatedPages; )
     {
-        int iterations = (fHandle->totalNumPages < numberOfPages) ? (numberOfPages - fHandle->totalNumPages) : 0;
+        PageNumber run = segmentRun(info, page, allocatedPages - page);
+        off_t start;
+        int fd = locatePage(info, page, &start);
+        off_t end = start + (off_t)run * info->pageSize;
 
-        if (fHandle->totalNumPages < numberOfPages)
+        if (fallocate(fd, 0, start, end - start) != 0)
         {
-            for (int i = 0; i < iterations && appendEmptyBlock(fHandle) == RC_OK; ++i)
-                ;
+            // filesystems without fallocate get a sparse extension instead,
+            // any other failure (ENOSPC, EIO, ...) means the space is not there
+            if ((errno != EOPNOTSUPP && errno != ENOSYS) || ftruncate(fd, end) != 0)
+                return RC_WRITE_FAILED;
         }
 
-        return RC_OK;
+        page += run;
+    }
+
+    info->header->allocatedPages = allocatedPages;
+    info->headerDirty = 1;
+    return RC_OK;
+}
+
+RC createPageFile(char *fileName)
+{
+    return createPageFileSized(fileName, PAGE_SIZE, 0);
+}
+
+RC createPageFileSegmented(char *fileName, PageNumber segmentPages)
+{
+    return createPageFileSized(fileName, PAGE_SIZE, segmentPages);
+}
+
+static int validPageSize(int pageSize)
+{
+    // a power of two keeps every page SM_IO_ALIGNMENT aligned on disk
+    return pageSize >= SM_MIN_PAGE_SIZE && pageSize <= SM_MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
+}
+
+static RC createFile(char *fileName, int pageSize, PageNumber segmentPages, int compressed)
+{
+    if (fileName == NULL || segmentPages < 0 || !validPageSize(pageSize))
+    {
+        return RC_INVALID_ARGUMENT;
+    }
+
+    SM_FileInfo info = {.fileName = fileName, .pageSize = pageSize, .header = allocHeader(), .headerDirty = 1,
+                        .syncLock = PTHREAD_MUTEX_INITIALIZER, .raLock = PTHREAD_MUTEX_INITIALIZER};
+
+    if (info.header == NULL || openSegments(&info, 1, 1) != RC_OK)
+    {
+        free(info.header);
+        closeSegments(&info);
+        return RC_WRITE_FAILED;
+    }
+
+    info.header->segmentPages = segmentPages;
+    info.header->pageSize = pageSize;
+    info.header->compressed = compressed;
+    info.header->dataEnd = SM_HEADER_SIZE;
+    RC result = allocateExtent(&info, 1);
+
+    if (result == RC_OK)
+    {
+        info.header->numPages = 1;
+        info.dirDirty = compressed;
+        result = flushHeader(&info);
     }
 
-    return RC_FILE_NOT_FOUND;
+    freeCompression(&info);
+    free(info.header);
+    closeSegments(&info);
+    return (result == RC_OK) ? RC_OK : RC_WRITE_FAILED;
+}
+
+RC createPageFileSized(char *fileName, int pageSize, PageNumber segmentPages)
+{
+    return createFile(fileName, pageSize, segmentPages, 0);
+}
+
+RC createPageFileCompressed(char *fileName, int pageSize)
+{
+    return createFile(fileName, pageSize, 0, 1);
+}
+
+static int compareRanges(const void *a, const void *b)
+{
+    PageNumber x = ((const SM_Range *)a)->offset, y = ((const SM_Range *)b)->offset;
+
+    return (x > y) - (x < y);
+}
+
+// read the page directory; whatever no slot covers becomes free space
+static RC loadDirectory(SM_FileInfo *info)
+{
+    SM_FileHeader *header = info->header;
+    PageNumber entries = header->dirBytes / (PageNumber)sizeof(SM_PageSlot);
+
+    if (header->segmentPages != 0 || header->dirOffset < SM_HEADER_SIZE || header->dirBytes < 0 ||
+        header->dirBytes % sizeof(SM_PageSlot) != 0 || entries > header->numPages ||
+        header->dirOffset + slotBytes(header->dirBytes) > header->dataEnd)
+        return RC_INVALID_PAGE_FILE;
+
+    if ((info->zbuf = malloc(info->pageSize)) == NULL ||
+        reserveDirectory(info, header->allocatedPages > header->numPages ? header->allocatedPages : header->numPages) != RC_OK)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    struct iovec iov = {.iov_base = info->dir, .iov_len = header->dirBytes};
+    if (entries > 0 && preadvFully(info, info->fd, &iov, 1, header->dirOffset) != RC_OK)
+        return RC_INVALID_PAGE_FILE;
+
+    SM_Range *used = malloc((entries + 1) * sizeof(SM_Range));
+    PageNumber numUsed = 0;
+
+    if (used == NULL)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    used[numUsed].offset = header->dirOffset;
+    used[numUsed++].length = slotBytes(header->dirBytes);
+
+    for (PageNumber i = 0; i < entries; i++)
+    {
+        SM_PageSlot *slot = &info->dir[i];
+
+        if (slot->length < 0 || slot->length > info->pageSize ||
+            (slot->length > 0 && (slot->offset < SM_HEADER_SIZE || slot->offset + slotBytes(slot->length) > header->dataEnd)))
+        {
+            free(used);
+            return RC_INVALID_PAGE_FILE;
+        }
+
+        if (slot->length > 0)
+        {
+            used[numUsed].offset = slot->offset;
+            used[numUsed++].length = slotBytes(slot->length);
+        }
+    }
+
+    qsort(used, numUsed, sizeof(SM_Range), compareRanges);
+
+    RC result = RC_OK;
+    PageNumber position = SM_HEADER_SIZE;
+    for (PageNumber i = 0; i < numUsed && result == RC_OK; i++)
+    {
+        // two slots claiming the same bytes cannot both be right
+        if (used[i].offset < position)
+            result = RC_INVALID_PAGE_FILE;
+        else
+            releaseSlot(info, position, used[i].offset - position);
+
+        position = used[i].offset + used[i].length;
+    }
+
+    if (result == RC_OK)
+        releaseSlot(info, position, header->dataEnd - position);
+
+    free(used);
+
+    // slots are neither sector sized nor aligned, so they always go through the page cache
+    if (result == RC_OK && info->direct)
+        disableDirectIO(info);
+
+    return result;
+}
+
+static void freeFileInfo(SM_FileInfo *info)
+{
+    closeSegments(info);
+    freeCompression(info);
+    pthread_mutex_destroy(&info->syncLock);
+    pthread_mutex_destroy(&info->raLock);
+    pthread_cond_destroy(&info->syncWake);
+    free(info->raBuf);
+    free(info->header);
+    free(info->fileName);
+    free(info);
+}
+
+static RC openPageFileWithFlags(char *fileName, SM_FileHandle *fHandle, int flags)
+{
+    SM_FileInfo *info = calloc(1, sizeof(SM_FileInfo));
+    struct stat st;
+
+    if (info == NULL)
+        return RC_FILE_NOT_FOUND;
+
+    pthread_mutex_init(&info->syncLock, NULL);
+    pthread_mutex_init(&info->raLock, NULL);
+    pthread_cond_init(&info->syncWake, NULL);
+
+    if ((info->fileName = strdup(fileName)) == NULL || (info->header = allocHeader()) == NULL)
+    {
+        freeFileInfo(info);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    info->openFlags = flags;
+    info->direct = (flags & O_DIRECT) != 0;
+    info->raWindow = SM_READAHEAD_MIN;
+    info->raMaxPages = SM_READAHEAD_MAX;
+
+    RC result = openSegments(info, 1, 0);
+    if (result != RC_OK)
+    {
+        freeFileInfo(info);
+        return result;
+    }
+
+    SM_FileHeader *header = info->header;
+    if (fstat(info->fd, &st) != 0 || st.st_size < SM_HEADER_SIZE || headerIO(info, 0) != RC_OK ||
+        memcmp(header->magic, SM_MAGIC, sizeof(header->magic)) != 0 || header->version != SM_VERSION ||
+        header->numPages < 0 || header->numPages > header->allocatedPages || header->segmentPages < 0 ||
+        (header->pageSize != 0 && !validPageSize(header->pageSize)) ||
+        header->durability < SM_SYNC_NONE || header->durability > SM_SYNC_WRITE_BEHIND ||
+        header->compressed < 0 || header->compressed > 1)
+    {
+        freeFileInfo(info);
+        return RC_INVALID_PAGE_FILE;
+    }
+
+    info->pageSize = (header->pageSize != 0) ? header->pageSize : PAGE_SIZE;
+
+    // a segment that is missing ends the file there, like a short last segment
+    openSegments(info, segmentsFor(info, header->allocatedPages), 0);
+
+    // an extent that never made it to disk is simply not allocated
+    PageNumber onDisk = pagesOnDisk(info);
+    if (header->allocatedPages > onDisk)
+        header->allocatedPages = onDisk > header->numPages ? onDisk : header->numPages;
+
+    // every page below numPages must have a segment file to live in
+    if (segmentsFor(info, header->allocatedPages) > info->numSegments)
+    {
+        freeFileInfo(info);
+        return RC_INVALID_PAGE_FILE;
+    }
+
+    if (header->compressed && (result = loadDirectory(info)) != RC_OK)
+    {
+        freeFileInfo(info);
+        return result;
+    }
+
+    fHandle->totalNumPages = header->numPages;
+    fHandle->fileName = fileName;
+    fHandle->curPagePos = 0;
+    fHandle->mgmtInfo = info;
+
+    return RC_OK;
+}
+
+RC openPageFile(char *fileName, SM_FileHandle *fHandle)
+{
+    return openPageFileWithFlags(fileName, fHandle, 0);
+}
+
+// opt-in direct I/O bypasses the kernel page cache; filesystems without
+// O_DIRECT support (tmpfs) get a regular descriptor instead
+RC openPageFileDirect(char *fileName, SM_FileHandle *fHandle)
+{
+    RC result = openPageFileWithFlags(fileName, fHandle, O_DIRECT);
+
+    if (result == RC_FILE_NOT_FOUND && errno == EINVAL)
+        result = openPageFileWithFlags(fileName, fHandle, 0);
+
+    return result;
+}
+
+int isDirectIO(SM_FileHandle *fHandle)
+{
+    fHandle = spaceFile(fHandle);
+    return fHandle != NULL && fHandle->mgmtInfo != NULL && getFileInfo(fHandle)->direct;
+}
+
+int isCompressed(SM_FileHandle *fHandle)
+{
+    fHandle = spaceFile(fHandle);
+    return fHandle != NULL && fHandle->mgmtInfo != NULL && getFileInfo(fHandle)->header->compressed;
+}
+
+// make sure the mapping covers fileBytes; the file itself must already be that long
+static RC reserveMapping(SM_FileInfo *info, size_t fileBytes)
+{
+    if (fileBytes <= info->mapLen)
+        return RC_OK;
+
+    size_t newLen = info->mapLen > SM_MAP_MIN_RESERVE ? info->mapLen : SM_MAP_MIN_RESERVE;
+    while (newLen < fileBytes)
+        newLen *= 2;
+
+    char *map = (info->map == NULL)
+                    ? mmap(NULL, newLen, PROT_READ | PROT_WRITE, MAP_SHARED, info->fd, 0)
+                    : mremap(info->map, info->mapLen, newLen, MREMAP_MAYMOVE);
+
+    if (map == MAP_FAILED)
+        return RC_FILE_OPEN_FAILED;
+
+    info->map = map;
+    info->mapLen = newLen;
+    return RC_OK;
+}
+
+RC openPageFileMapped(char *fileName, SM_FileHandle *fHandle)
+{
+    RC result = openPageFile(fileName, fHandle);
+
+    if (result != RC_OK)
+        return result;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    // one mapping cannot span several segment files, nor serve compressed slots
+    result = (info->header->segmentPages > 0 || info->header->compressed) ? RC_INVALID_ARGUMENT
+                                              : reserveMapping(info, pageOffset(info, info->header->allocatedPages));
+    if (result != RC_OK)
+        closePageFile(fHandle);
+
+    return result;
+}
+
+RC mapBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || getFileInfo(fHandle)->map == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    *memPage = getFileInfo(fHandle)->map + pageOffset(getFileInfo(fHandle), pageNum);
+    fHandle->curPagePos = pageNum;
+
+    return RC_OK;
+}
+
+RC syncBlocks(PageNumber startPage, int count, SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (startPage < 0 || count <= 0 || startPage > fHandle->totalNumPages - count)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    // a relation's pages are scattered over its extents, the whole tablespace
+    // is synced, after the size it reached is in the directory
+    if (getFileInfo(fHandle)->relation != NULL)
+    {
+        SM_FileHandle *space = spaceFile(fHandle);
+        RC result = flushSpaceDirectory(getFileInfo(fHandle)->space);
+        return (result != RC_OK) ? result : syncBlocks(0, (int)space->totalNumPages, space);
+    }
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    if (flushHeader(info) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    long long start = nowNanos();
+
+    if (info->map == NULL)
+    {
+        // the header lives in the first segment, the pages in whichever segments the range covers
+        RC result = (fdatasync(info->fd) == 0) ? RC_OK : RC_WRITE_FAILED;
+
+        for (PageNumber page = startPage; page < startPage + count && result == RC_OK; page += segmentRun(info, page, count))
+        {
+            off_t position;
+            int fd = locatePage(info, page, &position);
+
+            if (fd != info->fd && fdatasync(fd) != 0)
+                result = RC_WRITE_FAILED;
+        }
+
+        countSync(info, start);
+        return result;
+    }
+
+    // msync wants a start address aligned to the system page
+    size_t sysPage = (size_t)sysconf(_SC_PAGESIZE);
+    size_t first = pageOffset(info, startPage);
+    size_t end = pageOffset(info, startPage + count);
+    first -= first % sysPage;
+
+    RC result = (msync(info->map + first, end - first, MS_SYNC) == 0) ? RC_OK : RC_WRITE_FAILED;
+    countSync(info, start);
+    return result;
+}
+
+// durability policies: SM_SYNC_ON_FLUSH and SM_SYNC_WRITE_BEHIND sync in
+// syncPageFile, SM_SYNC_PERIODIC leaves it to a thread started by the first
+// write, and SM_SYNC_WRITE_BEHIND also starts write-back every few pages so
+// that final sync finds little left to do
+#define SM_DEFAULT_SYNC_INTERVAL_MS 1000
+#define SM_DEFAULT_WRITE_BEHIND_PAGES 64
+
+static RC syncWholeFile(SM_FileInfo *info)
+{
+    long long start = nowNanos();
+    RC result = RC_OK;
+
+    if (info->map != NULL)
+    {
+        if (msync(info->map, pageOffset(info, info->header->allocatedPages), MS_SYNC) != 0)
+            result = RC_WRITE_FAILED;
+    }
+    else
+    {
+        pthread_mutex_lock(&info->syncLock);
+        for (int i = 0; i < info->numSegments; i++)
+        {
+            if (fdatasync(info->segments[i]) != 0)
+                result = RC_WRITE_FAILED;
+        }
+        pthread_mutex_unlock(&info->syncLock);
+    }
+
+    countSync(info, start);
+    return result;
+}
+
+static void *periodicSyncer(void *arg)
+{
+    SM_FileInfo *info = arg;
+    struct timespec wake;
+
+    pthread_mutex_lock(&info->syncLock);
+    while (!info->syncerStop)
+    {
+        int interval = info->header->durabilityParam;
+
+        clock_gettime(CLOCK_REALTIME, &wake);
+        wake.tv_sec += interval / 1000;
+        wake.tv_nsec += (long)(interval % 1000) * 1000000;
+        if (wake.tv_nsec >= 1000000000)
+        {
+            wake.tv_sec++;
+            wake.tv_nsec -= 1000000000;
+        }
+
+        pthread_cond_timedwait(&info->syncWake, &info->syncLock, &wake);
+
+        // the segment array cannot change while syncLock is held
+        if (__atomic_exchange_n(&info->unsynced, 0, __ATOMIC_ACQ_REL))
+        {
+            long long start = nowNanos();
+
+            for (int i = 0; i < info->numSegments; i++)
+                fdatasync(info->segments[i]);
+            countSync(info, start);
+        }
+    }
+    pthread_mutex_unlock(&info->syncLock);
+
+    return NULL;
+}
+
+// the last round of a stopping syncer covers whatever is still unsynced
+static void stopSyncer(SM_FileInfo *info)
+{
+    if (!info->syncerRunning)
+        return;
+
+    pthread_mutex_lock(&info->syncLock);
+    info->syncerStop = 1;
+    pthread_cond_signal(&info->syncWake);
+    pthread_mutex_unlock(&info->syncLock);
+
+    pthread_join(info->syncer, NULL);
+    info->syncerRunning = 0;
+    info->syncerStop = 0;
+}
+
+// bookkeeping after pages were written (or queued for writing); writers of
+// pages inside the file may run concurrently, so the counters are atomic
+static void noteWrite(SM_FileInfo *info, int count)
+{
+    SM_FileHeader *header = info->header;
+
+    __atomic_store_n(&info->unsynced, 1, __ATOMIC_RELEASE);
+
+    if (header->durability == SM_SYNC_PERIODIC && !__atomic_load_n(&info->syncerRunning, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&info->syncLock);
+        if (!info->syncerRunning && pthread_create(&info->syncer, NULL, periodicSyncer, info) == 0)
+            __atomic_store_n(&info->syncerRunning, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&info->syncLock);
+    }
+
+    if (header->durability != SM_SYNC_WRITE_BEHIND)
+        return;
+
+    if (__atomic_add_fetch(&info->writtenPages, count, __ATOMIC_RELAXED) < header->durabilityParam)
+        return;
+
+    long long start = nowNanos();
+
+    pthread_mutex_lock(&info->syncLock);
+    for (int i = 0; i < info->numSegments; i++)
+        sync_file_range(info->segments[i], 0, 0, SYNC_FILE_RANGE_WRITE);
+    pthread_mutex_unlock(&info->syncLock);
+
+    __atomic_store_n(&info->writtenPages, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&info->stats.numWriteBehind, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&info->stats.writeBehindNanos, nowNanos() - start, __ATOMIC_RELAXED);
+}
+
+RC setDurability(SM_FileHandle *fHandle, SM_Durability policy, int param)
+{
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (policy < SM_SYNC_NONE || policy > SM_SYNC_WRITE_BEHIND || param < 0)
+        return RC_INVALID_ARGUMENT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    stopSyncer(info);
+
+    if (param == 0 && policy == SM_SYNC_PERIODIC)
+        param = SM_DEFAULT_SYNC_INTERVAL_MS;
+    if (param == 0 && policy == SM_SYNC_WRITE_BEHIND)
+        param = SM_DEFAULT_WRITE_BEHIND_PAGES;
+
+    info->header->durability = policy;
+    info->header->durabilityParam = param;
+    info->headerDirty = 1;
+    info->writtenPages = 0;
+    return RC_OK;
+}
+
+SM_Durability getDurability(SM_FileHandle *fHandle)
+{
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return SM_SYNC_NONE;
+
+    return (SM_Durability)getFileInfo(fHandle)->header->durability;
+}
+
+RC syncPageFile(SM_FileHandle *fHandle)
+{
+    // a relation's size is written whatever the policy, as closePageFile writes the header
+    if (fHandle != NULL && fHandle->mgmtInfo != NULL && getFileInfo(fHandle)->relation != NULL)
+    {
+        RC result = flushSpaceDirectory(getFileInfo(fHandle)->space);
+        if (result != RC_OK)
+            return result;
+    }
+
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+    int policy = info->header->durability;
+
+    if (policy != SM_SYNC_ON_FLUSH && policy != SM_SYNC_WRITE_BEHIND)
+        return RC_OK;
+
+    if (flushHeader(info) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    __atomic_store_n(&info->unsynced, 0, __ATOMIC_RELEASE);
+    info->writtenPages = 0;
+    return syncWholeFile(info);
+}
+
+RC getFileStats(SM_FileHandle *fHandle, SM_FileStats *stats)
+{
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || stats == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // every field is a counter, copy them one by one so none is torn
+    long long *src = (long long *)&getFileInfo(fHandle)->stats;
+    long long *dst = (long long *)stats;
+
+    for (size_t i = 0; i < sizeof(SM_FileStats) / sizeof(long long); i++)
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+
+    return RC_OK;
+}
+
+RC resetFileStats(SM_FileHandle *fHandle)
+{
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    long long *counters = (long long *)&getFileInfo(fHandle)->stats;
+
+    for (size_t i = 0; i < sizeof(SM_FileStats) / sizeof(long long); i++)
+        __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+
+    return RC_OK;
+}
+
+long long getLatencyPercentile(long long histogram[SM_LATENCY_BUCKETS], double percentile)
+{
+    long long total = 0, seen = 0;
+
+    for (int i = 0; i < SM_LATENCY_BUCKETS; i++)
+        total += histogram[i];
+
+    if (total == 0)
+        return 0;
+
+    for (int i = 0; i < SM_LATENCY_BUCKETS; i++)
+    {
+        seen += histogram[i];
+        if (seen * 100.0 >= total * percentile)
+            return 2LL << i;
+    }
+
+    return 2LL << (SM_LATENCY_BUCKETS - 1);
+}
+
+static void printHistogram(const char *name, long long histogram[SM_LATENCY_BUCKETS])
+{
+    printf("%s latency: p50 <%lldns p99 <%lldns\n", name,
+           getLatencyPercentile(histogram, 50), getLatencyPercentile(histogram, 99));
+
+    for (int i = 0; i < SM_LATENCY_BUCKETS; i++)
+    {
+        if (histogram[i] != 0)
+            printf("  [%lld, %lld) ns: %lld\n", 1LL << i, 2LL << i, histogram[i]);
+    }
+}
+
+void printFileStats(SM_FileHandle *fHandle)
+{
+    SM_FileStats stats;
+
+    if (getFileStats(fHandle, &stats) != RC_OK)
+        return;
+
+    printf("{%s}\n", fHandle->fileName);
+    printf("read: %lld bytes in %lld calls, write: %lld bytes in %lld calls\n",
+           stats.bytesRead, stats.numReadCalls, stats.bytesWritten, stats.numWriteCalls);
+    printf("accesses: %lld sequential, %lld random\n", stats.numSequential, stats.numRandom);
+    printf("syncs: %lld in %lldns, write-behind: %lld in %lldns\n",
+           stats.numSyncs, stats.syncNanos, stats.numWriteBehind, stats.writeBehindNanos);
+    printHistogram("read", stats.readLatency);
+    printHistogram("write", stats.writeLatency);
+}
+
+RC closePageFile(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+    {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    if (info->relation != NULL)
+        return closeRelation(fHandle);
+
+    shutdownAsyncIO(fHandle);
+    stopSyncer(info);
+
+    RC result = flushHeader(info);
+
+    if (info->map != NULL)
+        munmap(info->map, info->mapLen);
+
+    if (closeSegments(info) != RC_OK)
+        result = RC_WRITE_FAILED;
+
+    freeFileInfo(info);
+
+    fHandle->fileName = NULL;
+    fHandle->curPagePos = 0;
+    fHandle->totalNumPages = 0;
+    fHandle->mgmtInfo = NULL;
+
+    return result;
+}
+
+RC destroyPageFile(char *fileName)
+{
+    SM_FileHandle fHandle;
+    PageNumber segmentPages = 0;
+
+    // only the header knows whether "fileName.1", "fileName.2", ... belong to this file
+    if (openPageFile(fileName, &fHandle) == RC_OK)
+    {
+        segmentPages = getSegmentPages(&fHandle);
+        closePageFile(&fHandle);
+    }
+
+    if (unlink(fileName) != 0)
+        return RC_FILE_NOT_FOUND;
+
+    for (int segment = 1; segmentPages > 0; segment++)
+    {
+        char *name = segmentName(fileName, segment);
+        int removed = (name != NULL && unlink(name) == 0);
+
+        free(name);
+        if (!removed)
+            break;
+    }
+
+    return RC_OK;
+}
+
+int getPageSize(SM_FileHandle *fHandle)
+{
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return PAGE_SIZE;
+
+    return getFileInfo(fHandle)->pageSize;
+}
+
+RC setReadahead(SM_FileHandle *fHandle, int maxPages)
+{
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (maxPages < 0 || maxPages > SM_READAHEAD_MAX)
+        return RC_INVALID_ARGUMENT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    // the staging cache is sized for the cap, let the next readahead allocate it again
+    pthread_mutex_lock(&info->raLock);
+    free(info->raBuf);
+    info->raBuf = NULL;
+    info->raCount = 0;
+    info->raRun = 0;
+    info->raMaxPages = maxPages;
+    info->raWindow = SM_READAHEAD_MIN;
+    pthread_mutex_unlock(&info->raLock);
+    return RC_OK;
+}
+
+PageNumber getSegmentPages(SM_FileHandle *fHandle)
+{
+    fHandle = spaceFile(fHandle);
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return 0;
+
+    return getFileInfo(fHandle)->header->segmentPages;
+}
+
+RC readBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    return readBlocks(pageNum, 1, fHandle, &memPage);
+}
+
+// sequential reads needed before readahead kicks in
+#define SM_READAHEAD_TRIGGER 2
+
+static void adviseSegments(SM_FileInfo *info, int advice)
+{
+    for (int i = 0; i < info->numSegments; i++)
+        posix_fadvise(info->segments[i], 0, 0, advice);
+}
+
+static void dropStaged(SM_FileInfo *info, PageNumber startPage, int count)
+{
+    pthread_mutex_lock(&info->raLock);
+    if (startPage < info->raStart + info->raCount && startPage + count > info->raStart)
+        info->raCount = 0;
+    pthread_mutex_unlock(&info->raLock);
+}
+
+static int copyStaged(SM_FileInfo *info, PageNumber startPage, int count, SM_PageHandle pages[])
+{
+    if (info->raCount == 0 || startPage < info->raStart || startPage + count > info->raStart + info->raCount)
+        return 0;
+
+    for (int i = 0; i < count; i++)
+        memcpy(pages[i], info->raBuf + (size_t)(startPage - info->raStart + i) * info->pageSize, info->pageSize);
+
+    return 1;
+}
+
+// reads that continue the previous one build up a run; from the
+// SM_READAHEAD_TRIGGER-th on, a miss fetches a whole window into the staging
+// cache, doubling the window up to raMaxPages, and asks the kernel to start on
+// the window after it. Anything else resets the run and reads straight through.
+// raLock is held while the window is filled, reads that bypass it drop the lock first.
+static RC readStaged(SM_FileHandle *fHandle, SM_FileInfo *info, PageNumber startPage, int count, SM_PageHandle pages[])
+{
+    pthread_mutex_lock(&info->raLock);
+
+    int sequential = (startPage == info->raNext);
+
+    info->raNext = startPage + count;
+
+    if (copyStaged(info, startPage, count, pages))
+    {
+        pthread_mutex_unlock(&info->raLock);
+        return RC_OK;
+    }
+
+    if (!sequential)
+    {
+        if (info->raAdvised)
+            adviseSegments(info, POSIX_FADV_NORMAL);
+
+        info->raRun = 0;
+        info->raAdvised = 0;
+        info->raWindow = SM_READAHEAD_MIN;
+    }
+
+    PageNumber window = info->raWindow < info->raMaxPages ? info->raWindow : info->raMaxPages;
+    if (window > fHandle->totalNumPages - startPage)
+        window = fHandle->totalNumPages - startPage;
+
+    if (!sequential || ++info->raRun < SM_READAHEAD_TRIGGER || window <= count)
+    {
+        pthread_mutex_unlock(&info->raLock);
+        return transferPages(info, startPage, count, pages, 0);
+    }
+
+    if (info->raBuf == NULL &&
+        posix_memalign((void **)&info->raBuf, SM_IO_ALIGNMENT, (size_t)info->raMaxPages * info->pageSize) != 0)
+    {
+        info->raBuf = NULL;
+        pthread_mutex_unlock(&info->raLock);
+        return transferPages(info, startPage, count, pages, 0);
+    }
+
+    if (!info->raAdvised)
+    {
+        adviseSegments(info, POSIX_FADV_SEQUENTIAL);
+        info->raAdvised = 1;
+    }
+
+    SM_PageHandle staged[SM_READAHEAD_MAX];
+    for (int i = 0; i < window; i++)
+        staged[i] = info->raBuf + (size_t)i * info->pageSize;
+
+    info->raCount = 0;
+    if (transferPages(info, startPage, (int)window, staged, 0) != RC_OK)
+    {
+        pthread_mutex_unlock(&info->raLock);
+        return transferPages(info, startPage, count, pages, 0);
+    }
+
+    info->raStart = startPage;
+    info->raCount = (int)window;
+    info->raWindow = info->raWindow * 2 < info->raMaxPages ? info->raWindow * 2 : info->raMaxPages;
+
+    PageNumber next = startPage + window;
+    if (next < fHandle->totalNumPages)
+    {
+        off_t position;
+        int fd = locatePage(info, next, &position);
+        PageNumber ahead = segmentRun(info, next, fHandle->totalNumPages - next < info->raWindow ? fHandle->totalNumPages - next : info->raWindow);
+
+        posix_fadvise(fd, position, (off_t)ahead * info->pageSize, POSIX_FADV_WILLNEED);
+    }
+
+    copyStaged(info, startPage, count, pages);
+    pthread_mutex_unlock(&info->raLock);
+    return RC_OK;
+}
+
+static RC readCompressed(SM_FileInfo *info, PageNumber startPage, int count, SM_PageHandle pages[])
+{
+    for (int i = 0; i < count; i++)
+    {
+        SM_PageSlot *slot = &info->dir[startPage + i];
+        int stored = slot->length == info->pageSize;
+        struct iovec iov = {.iov_base = stored ? pages[i] : info->zbuf, .iov_len = slot->length};
+
+        if (slot->length == 0)
+        {
+            memset(pages[i], 0, info->pageSize);
+            continue;
+        }
+
+        if (preadvFully(info, info->fd, &iov, 1, slot->offset) != RC_OK)
+            return RC_READ_NON_EXISTING_PAGE;
+
+        if (!stored && lzDecompress(info->zbuf, slot->length, pages[i], info->pageSize) != info->pageSize)
+            return RC_CORRUPT_PAGE;
+    }
+
+    return RC_OK;
+}
+
+// every write goes to a new slot and the old one is only reused after the
+// directory in the file stops pointing at it, so the file always describes
+// pages that were completely written
+static RC writeCompressed(SM_FileInfo *info, PageNumber startPage, int count, SM_PageHandle pages[])
+{
+    for (int i = 0; i < count; i++)
+    {
+        SM_PageSlot *slot = &info->dir[startPage + i];
+        char *image = pages[i];
+        int length = 0;
+
+        if (memcmp(pages[i], zeroPage, info->pageSize) != 0)
+        {
+            // stored as is unless compression saves at least one slot unit
+            length = lzCompress(pages[i], info->pageSize, info->zbuf, info->pageSize - SM_SLOT_ALIGN);
+            image = (length > 0) ? info->zbuf : pages[i];
+            length = (length > 0) ? length : info->pageSize;
+        }
+
+        PageNumber offset = (length > 0) ? allocSlot(info, slotBytes(length)) : 0;
+        struct iovec iov = {.iov_base = image, .iov_len = length};
+
+        if (length > 0 && pwritevFully(info, info->fd, &iov, 1, offset) != RC_OK)
+        {
+            releaseSlot(info, offset, slotBytes(length));
+            return RC_WRITE_FAILED;
+        }
+
+        retireSlot(info, slot->offset, slotBytes(slot->length));
+        slot->offset = offset;
+        slot->length = length;
+        info->dirDirty = 1;
+    }
+
+    return (info->numRetired >= SM_RETIRE_LIMIT) ? flushHeader(info) : RC_OK;
+}
+
+RC readBlocks(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[])
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || startPage < 0 || count <= 0 || startPage > fHandle->totalNumPages - count)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+    long long start = nowNanos();
+
+    if (info->relation != NULL)
+        return relationIO(fHandle, startPage, count, pages, 0);
+
+    countAccess(info, startPage, count);
+
+    for (int done = 0; done < count && info->map != NULL; done++)
+        memcpy(pages[done], info->map + pageOffset(info, startPage + done), info->pageSize);
+
+    RC result = RC_OK;
+    if (info->map != NULL)
+        countTransfer(info, 0, (long long)count * info->pageSize, 0);
+    else if (info->header->compressed)
+        result = readCompressed(info, startPage, count, pages);
+    else if (readStaged(fHandle, info, startPage, count, pages) != RC_OK)
+        result = RC_READ_NON_EXISTING_PAGE;
+
+    if (result != RC_OK)
+        return result;
+
+    // several threads may read through one handle, the position is whichever came last
+    __atomic_store_n(&fHandle->curPagePos, startPage + count - 1, __ATOMIC_RELAXED);
+    countLatency(info->stats.readLatency, start);
+
+    return RC_OK;
+}
+
+extern PageNumber getBlockPos(SM_FileHandle *fHandle)
+{
+    return fHandle->curPagePos;
+}
+
+RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    if (readBlock(0, fHandle, memPage) == RC_OK)
+        return RC_OK;
+
+    return RC_READ_NON_EXISTING_PAGE;
+}
+
+RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    if (readBlock(fHandle->curPagePos - 1, fHandle, memPage) == RC_OK)
+        return RC_OK;
+
+    return RC_READ_NON_EXISTING_PAGE;
+}
+
+RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    if (readBlock(getBlockPos(fHandle), fHandle, memPage) == RC_OK)
+    {
+        return RC_OK;
+    }
+
+    return RC_READ_NON_EXISTING_PAGE;
+}
+
+RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    if (readBlock(fHandle->curPagePos + 1, fHandle, memPage) == RC_OK)
+    {
+        return RC_OK;
+    }
+
+    return RC_READ_NON_EXISTING_PAGE;
+}
+
+RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    if (readBlock(fHandle->totalNumPages - 1, fHandle, memPage) == RC_OK)
+    {
+        return RC_OK;
+    }
+
+    return RC_READ_NON_EXISTING_PAGE;
+}
+
+RC writeBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    return writeBlocks(pageNum, 1, fHandle, &memPage);
+}
+
+RC writeBlocks(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[])
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+    {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    // the run may start at most one past the end, the file grows to cover it
+    if (startPage < 0 || count <= 0 || startPage > fHandle->totalNumPages)
+    {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+    long long start = nowNanos();
+
+    if (startPage + count > fHandle->totalNumPages)
+    {
+        RC result = ensureCapacity(startPage + count, fHandle);
+        if (result != RC_OK)
+            return result;
+    }
+
+    // relation I/O is counted once, by the tablespace file it lands in
+    if (info->relation != NULL)
+        return relationIO(fHandle, startPage, count, pages, 1);
+
+    countAccess(info, startPage, count);
+
+    for (int done = 0; done < count && info->map != NULL; done++)
+        memcpy(info->map + pageOffset(info, startPage + done), pages[done], info->pageSize);
+
+    RC result = RC_OK;
+    if (info->map != NULL)
+        countTransfer(info, 1, (long long)count * info->pageSize, 0);
+    else if (info->header->compressed)
+        result = writeCompressed(info, startPage, count, pages);
+    else if (transferPages(info, startPage, count, pages, 1) != RC_OK)
+        result = RC_WRITE_FAILED;
+
+    // dropped after the write, a readahead that overlapped it may have staged the old image
+    dropStaged(info, startPage, count);
+    if (result != RC_OK)
+        return result;
+
+    noteWrite(info, count);
+
+    __atomic_store_n(&fHandle->curPagePos, startPage + count - 1, __ATOMIC_RELAXED);
+    countLatency(info->stats.writeLatency, start);
+    return RC_OK;
+}
+
+RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+    {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    PageNumber currentBlockPos = getBlockPos(fHandle);
+
+    RC result = writeBlock(currentBlockPos, fHandle, memPage);
+
+    if (result != RC_OK)
+    {
+        return result;
+    }
+
+    fHandle->curPagePos++;
+    return RC_OK;
+}
+
+RC appendEmptyBlock(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+    {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    return ensureCapacity(fHandle->totalNumPages + 1, fHandle);
+}
+
+// pages inside the allocated extent are already zero on disk, so growing the
+// logical size only touches the header; running out allocates the next extent
+RC ensureCapacity(PageNumber numberOfPages, SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+    {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    if (numberOfPages <= fHandle->totalNumPages)
+    {
+        return RC_OK;
+    }
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+    SM_FileHeader *header = info->header;
+
+    if (info->relation != NULL)
+        return growRelation(fHandle, numberOfPages);
+
+    if (numberOfPages > header->allocatedPages)
+    {
+        PageNumber extent = header->allocatedPages;
+
+        extent = extent < SM_MIN_EXTENT ? SM_MIN_EXTENT : extent;
+        extent = extent > SM_MAX_EXTENT ? SM_MAX_EXTENT : extent;
+
+        PageNumber allocated = header->allocatedPages + extent;
+        if (allocated < numberOfPages)
+            allocated = numberOfPages;
+
+        if (allocateExtent(info, allocated) != RC_OK)
+        {
+            return RC_WRITE_FAILED;
+        }
+
+        // write the header with every new extent so a crash loses at most the tail of one
+        if (flushHeader(info) != RC_OK)
+        {
+            return RC_WRITE_FAILED;
+        }
+    }
+
+    if (info->map != NULL && reserveMapping(info, pageOffset(info, header->allocatedPages)) != RC_OK)
+    {
+        return RC_WRITE_FAILED;
+    }
+
+    header->numPages = numberOfPages;
+    info->headerDirty = 1;
+
+    fHandle->totalNumPages = numberOfPages;
+    fHandle->curPagePos = numberOfPages - 1;
+
+    return RC_OK;
+}
+
+PageNumber getAllocatedBlocks(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return 0;
+
+    if (getFileInfo(fHandle)->relation != NULL)
+        return relationCapacity(getFileInfo(fHandle)->relation);
+
+    return getFileInfo(fHandle)->header->allocatedPages;
+}
+
+static unsigned char *getFreeMap(SM_FileInfo *info)
+{
+    return (unsigned char *)info->header + SM_FREEMAP_OFFSET;
+}
+
+static int isPageFree(SM_FileInfo *info, PageNumber pageNum)
+{
+    return pageNum >= 0 && pageNum < SM_FREEMAP_PAGES && (getFreeMap(info)[pageNum / 8] >> (pageNum % 8)) & 1;
+}
+
+static void setPageFree(SM_FileInfo *info, PageNumber pageNum, int isFree)
+{
+    unsigned char bit = (unsigned char)(1 << (pageNum % 8));
+
+    if (isFree)
+        getFreeMap(info)[pageNum / 8] |= bit;
+    else
+        getFreeMap(info)[pageNum / 8] &= (unsigned char)~bit;
+
+    info->header->freePages += isFree ? 1 : -1;
+    info->headerDirty = 1;
+}
+
+// hand out a freed page if the map has one, otherwise grow the file by a page;
+// a reused page is zeroed so it looks exactly like a freshly appended one
+RC allocatePage(SM_FileHandle *fHandle, PageNumber *pageNum)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+    PageNumber limit = fHandle->totalNumPages < SM_FREEMAP_PAGES ? fHandle->totalNumPages : SM_FREEMAP_PAGES;
+
+    if (info->relation != NULL)
+        return allocateRelationPage(fHandle, pageNum);
+
+    for (int byte = 0; info->header->freePages > 0 && byte * 8 < limit; byte++)
+    {
+        if (getFreeMap(info)[byte] == 0)
+            continue;
+
+        PageNumber page = byte * 8;
+        while (!isPageFree(info, page))
+            page++;
+
+        SM_PageHandle empty_page = (SM_PageHandle)zeroPage;
+        RC result = writeBlocks(page, 1, fHandle, &empty_page);
+        if (result != RC_OK)
+            return result;
+
+        setPageFree(info, page, 0);
+        *pageNum = page;
+        return RC_OK;
+    }
+
+    RC result = appendEmptyBlock(fHandle);
+    if (result == RC_OK)
+        *pageNum = fHandle->totalNumPages - 1;
+
+    return result;
+}
+
+RC freePage(PageNumber pageNum, SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    if (info->relation != NULL)
+        return freeRelationPage(fHandle, pageNum);
+
+    // pages past the reach of the map are simply never reused
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages || pageNum >= SM_FREEMAP_PAGES)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    if (isPageFree(info, pageNum))
+        return RC_OK;
+
+    setPageFree(info, pageNum, 1);
+
+    // a freed compressed page gives its slot up right away
+    if (info->header->compressed)
+    {
+        SM_PageSlot *slot = &info->dir[pageNum];
+
+        retireSlot(info, slot->offset, slotBytes(slot->length));
+        slot->length = 0;
+        info->dirDirty = 1;
+        return RC_OK;
+    }
+
+    int runPages = info->header->holeRunPages;
+    if (runPages <= 0)
+        return RC_OK;
+
+    PageNumber first = pageNum, last = pageNum;
+    while (first > 0 && isPageFree(info, first - 1))
+        first--;
+    while (last + 1 < fHandle->totalNumPages && isPageFree(info, last + 1))
+        last++;
+
+    // punch the whole run the moment it reaches the threshold, afterwards only the page that grew it
+    if (last - first + 1 < runPages)
+        return RC_OK;
+    if (last - first + 1 > runPages)
+        first = last = pageNum;
+
+    for (PageNumber page = first; page <= last; )
+    {
+        PageNumber run = segmentRun(info, page, last - page + 1);
+        off_t position;
+        int fd = locatePage(info, page, &position);
+
+        if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, position, (off_t)run * info->pageSize) != 0 &&
+            errno != EOPNOTSUPP)
+            return RC_WRITE_FAILED;
+
+        page += run;
+    }
+
+    return RC_OK;
+}
+
+PageNumber getNumFreePages(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return 0;
+
+    if (getFileInfo(fHandle)->relation != NULL)
+        return relationFreePages(getFileInfo(fHandle)->relation);
+
+    return getFileInfo(fHandle)->header->freePages;
+}
+
+RC setHolePunching(SM_FileHandle *fHandle, int minRunPages)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    if (info->relation != NULL)
+        return RC_INVALID_ARGUMENT;
+
+    info->header->holeRunPages = minRunPages > 0 ? minRunPages : 0;
+    info->headerDirty = 1;
+    return RC_OK;
+}
+
+// asynchronous block I/O: requests go to an io_uring instance driven through raw
+// syscalls, or to a small pool of worker threads doing pread/pwrite when the
+// kernel (or a seccomp filter) refuses io_uring. Submit and reap on one handle
+// are expected to come from a single thread, the buffer manager.
+typedef struct SM_AsyncRequest
+{
+    void *cookie;
+    SM_PageHandle memPage;
+    PageNumber pageNum;
+    int isWrite;
+    struct iovec iov; // must stay put until the kernel has consumed the SQE
+} SM_AsyncRequest;
+
+typedef struct SM_AsyncDone
+{
+    void *cookie;
+    PageNumber pageNum;
+    RC result;
+    int slot;
+} SM_AsyncDone;
+
+typedef struct SM_AsyncQueue
+{
+    SM_FileInfo *info;
+    int depth;
+    int flags;
+    SM_AsyncRequest *requests; // one slot per queue entry, the slot index is the user_data
+    int *freeSlots;
+    int numFree;
+
+    // io_uring backend, ringFd is -1 when the thread pool is used
+    int ringFd;
+    void *sqRing;
+    size_t sqRingLen;
+    void *cqRing;
+    size_t cqRingLen;
+    struct io_uring_sqe *sqes;
+    size_t sqesLen;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    unsigned toSubmit; // SQEs published to the ring but not yet accepted by io_uring_enter
+
+    // thread-pool backend
+    pthread_mutex_t lock;
+    pthread_cond_t workReady;
+    pthread_cond_t doneReady;
+    int *pending; // FIFO of slots waiting for a worker
+    int pendHead;
+    int pendCount;
+    SM_AsyncDone *done; // finished requests waiting to be reaped, their slots stay taken until then
+    int doneHead;
+    int doneCount;
+    pthread_t *workers;
+    int numWorkers;
+    int stopping;
+} SM_AsyncQueue;
+
+#define SM_ASYNC_MAX_WORKERS 4
+
+static RC transferOne(SM_FileInfo *info, PageNumber pageNum, SM_PageHandle memPage, int isWrite)
+{
+    if (info->map != NULL)
+    {
+        char *page = info->map + pageOffset(info, pageNum);
+
+        memcpy(isWrite ? page : memPage, isWrite ? memPage : page, info->pageSize);
+        countTransfer(info, isWrite, info->pageSize, 0);
+        return RC_OK;
+    }
+
+    return transferPages(info, pageNum, 1, &memPage, isWrite);
+}
+
+static int ringEnter(SM_AsyncQueue *q, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, q->ringFd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static void teardownRing(SM_AsyncQueue *q)
+{
+    if (q->sqes != NULL && q->sqes != MAP_FAILED)
+        munmap(q->sqes, q->sqesLen);
+    if (q->cqRing != NULL && q->cqRing != MAP_FAILED && q->cqRing != q->sqRing)
+        munmap(q->cqRing, q->cqRingLen);
+    if (q->sqRing != NULL && q->sqRing != MAP_FAILED)
+        munmap(q->sqRing, q->sqRingLen);
+    if (q->ringFd >= 0)
+        close(q->ringFd);
+
+    q->ringFd = -1;
+}
+
+static int setupRing(SM_AsyncQueue *q)
+{
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    q->ringFd = (int)syscall(__NR_io_uring_setup, (unsigned)q->depth, &params);
+    if (q->ringFd < 0)
+        return -1;
+
+    q->sqRingLen = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    q->cqRingLen = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        q->sqRingLen = q->sqRingLen > q->cqRingLen ? q->sqRingLen : q->cqRingLen;
+        q->cqRingLen = q->sqRingLen;
+    }
+
+    q->sqRing = mmap(NULL, q->sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, q->ringFd, IORING_OFF_SQ_RING);
+    q->cqRing = (params.features & IORING_FEAT_SINGLE_MMAP)
+                    ? q->sqRing
+                    : mmap(NULL, q->cqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, q->ringFd, IORING_OFF_CQ_RING);
+    q->sqesLen = params.sq_entries * sizeof(struct io_uring_sqe);
+    q->sqes = mmap(NULL, q->sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, q->ringFd, IORING_OFF_SQES);
+
+    if (q->sqRing == MAP_FAILED || q->cqRing == MAP_FAILED || q->sqes == MAP_FAILED)
+    {
+        teardownRing(q);
+        return -1;
+    }
+
+    q->sqTail = (unsigned *)((char *)q->sqRing + params.sq_off.tail);
+    q->sqMask = (unsigned *)((char *)q->sqRing + params.sq_off.ring_mask);
+    q->sqArray = (unsigned *)((char *)q->sqRing + params.sq_off.array);
+    q->cqHead = (unsigned *)((char *)q->cqRing + params.cq_off.head);
+    q->cqTail = (unsigned *)((char *)q->cqRing + params.cq_off.tail);
+    q->cqMask = (unsigned *)((char *)q->cqRing + params.cq_off.ring_mask);
+    q->cqes = (struct io_uring_cqe *)((char *)q->cqRing + params.cq_off.cqes);
+
+    return 0;
+}
+
+static void *asyncWorker(void *arg)
+{
+    SM_AsyncQueue *q = arg;
+
+    pthread_mutex_lock(&q->lock);
+    for (;;)
+    {
+        while (q->pendCount == 0 && !q->stopping)
+            pthread_cond_wait(&q->workReady, &q->lock);
+
+        if (q->pendCount == 0)
+            break;
+
+        int slot = q->pending[q->pendHead];
+        q->pendHead = (q->pendHead + 1) % q->depth;
+        q->pendCount--;
+        pthread_mutex_unlock(&q->lock);
+
+        SM_AsyncRequest *req = &q->requests[slot];
+        RC result = transferOne(q->info, req->pageNum, req->memPage, req->isWrite);
+
+        pthread_mutex_lock(&q->lock);
+        SM_AsyncDone *c = &q->done[(q->doneHead + q->doneCount) % q->depth];
+        c->cookie = req->cookie;
+        c->pageNum = req->pageNum;
+        c->result = result;
+        c->slot = slot;
+        q->doneCount++;
+        pthread_cond_signal(&q->doneReady);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+static void freeAsyncQueue(SM_AsyncQueue *q)
+{
+    free(q->requests);
+    free(q->freeSlots);
+    free(q->pending);
+    free(q->done);
+    free(q->workers);
+    free(q);
+}
+
+RC initAsyncIO(SM_FileHandle *fHandle, int queueDepth, int flags)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    if (info->async != NULL)
+        return RC_OK;
+    if (queueDepth <= 0 || info->relation != NULL || info->header->compressed)
+        return RC_INVALID_ARGUMENT;
+
+    SM_AsyncQueue *q = calloc(1, sizeof(SM_AsyncQueue));
+    if (q == NULL)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    q->info = info;
+    q->depth = queueDepth;
+    q->flags = flags;
+    q->ringFd = -1;
+    q->requests = calloc(queueDepth, sizeof(SM_AsyncRequest));
+    q->freeSlots = malloc(queueDepth * sizeof(int));
+    q->pending = malloc(queueDepth * sizeof(int));
+    q->done = malloc(queueDepth * sizeof(SM_AsyncDone));
+    q->workers = malloc(SM_ASYNC_MAX_WORKERS * sizeof(pthread_t));
+
+    if (q->requests == NULL || q->freeSlots == NULL || q->pending == NULL || q->done == NULL || q->workers == NULL)
+    {
+        freeAsyncQueue(q);
+        return RC_MEMORY_ALLOCATION_FAILED;
+    }
+
+    for (int i = 0; i < queueDepth; i++)
+        q->freeSlots[q->numFree++] = queueDepth - 1 - i;
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->workReady, NULL);
+    pthread_cond_init(&q->doneReady, NULL);
+
+    // mapped files are served by memcpy, io_uring would only add a syscall
+    if ((flags & SM_ASYNC_THREADS) || info->map != NULL || setupRing(q) != 0)
+    {
+        int wanted = queueDepth < SM_ASYNC_MAX_WORKERS ? queueDepth : SM_ASYNC_MAX_WORKERS;
+
+        while (q->numWorkers < wanted && pthread_create(&q->workers[q->numWorkers], NULL, asyncWorker, q) == 0)
+            q->numWorkers++;
+
+        if (q->numWorkers == 0)
+        {
+            pthread_mutex_destroy(&q->lock);
+            pthread_cond_destroy(&q->workReady);
+            pthread_cond_destroy(&q->doneReady);
+            freeAsyncQueue(q);
+            return RC_ERROR;
+        }
+    }
+
+    info->async = q;
+    return RC_OK;
+}
+
+int isAsyncRing(SM_FileHandle *fHandle)
+{
+    return fHandle != NULL && fHandle->mgmtInfo != NULL && getFileInfo(fHandle)->async != NULL &&
+           getFileInfo(fHandle)->async->ringFd >= 0;
+}
+
+static SM_AsyncQueue *getAsyncQueue(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return NULL;
+
+    return getFileInfo(fHandle)->async;
+}
+
+static RC submitRequest(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *cookie, int isWrite)
+{
+    SM_AsyncQueue *q = getAsyncQueue(fHandle);
+
+    if (q == NULL)
+        return RC_ASYNC_NOT_INIT;
+
+    if (pageNum < 0 || pageNum > fHandle->totalNumPages || (!isWrite && pageNum == fHandle->totalNumPages))
+        return RC_READ_NON_EXISTING_PAGE;
+
+    // appends are not done concurrently, the page is allocated before the write is queued
+    if (isWrite && pageNum == fHandle->totalNumPages)
+    {
+        RC result = ensureCapacity(pageNum + 1, fHandle);
+        if (result != RC_OK)
+            return result;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    if (q->numFree == 0)
+    {
+        pthread_mutex_unlock(&q->lock);
+        return RC_ASYNC_QUEUE_FULL;
+    }
+
+    countAccess(q->info, pageNum, 1);
+
+    int slot = q->freeSlots[--q->numFree];
+    SM_AsyncRequest *req = &q->requests[slot];
+
+    req->cookie = cookie;
+    req->memPage = memPage;
+    req->pageNum = pageNum;
+    req->isWrite = isWrite;
+    req->iov.iov_base = memPage;
+    req->iov.iov_len = q->info->pageSize;
+
+    if (q->ringFd < 0)
+    {
+        q->pending[(q->pendHead + q->pendCount) % q->depth] = slot;
+        q->pendCount++;
+        pthread_cond_signal(&q->workReady);
+        pthread_mutex_unlock(&q->lock);
+        return RC_OK;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    unsigned tail = *q->sqTail;
+    unsigned index = tail & *q->sqMask;
+    struct io_uring_sqe *sqe = &q->sqes[index];
+    off_t position;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = locatePage(q->info, pageNum, &position);
+    sqe->addr = (unsigned long)&req->iov;
+    sqe->len = 1;
+    sqe->off = position;
+    sqe->user_data = slot;
+    q->sqArray[index] = index;
+    __atomic_store_n(q->sqTail, tail + 1, __ATOMIC_RELEASE);
+    q->toSubmit++;
+
+    // a refused enter leaves the SQE in the ring, the next enter picks it up
+    int submitted = ringEnter(q, q->toSubmit, 0, 0);
+    if (submitted > 0)
+        q->toSubmit -= submitted;
+
+    return RC_OK;
+}
+
+RC submitRead(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *cookie)
+{
+    return submitRequest(pageNum, fHandle, memPage, cookie, 0);
+}
+
+RC submitWrite(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *cookie)
+{
+    RC result = submitRequest(pageNum, fHandle, memPage, cookie, 1);
+
+    if (result == RC_OK)
+    {
+        dropStaged(getFileInfo(fHandle), pageNum, 1);
+        noteWrite(getFileInfo(fHandle), 1);
+    }
+
+    return result;
+}
+
+static int reapRing(SM_AsyncQueue *q, SM_Completion *completions, int maxCompletions, int minCompletions)
+{
+    int got = 0;
+
+    while (got < maxCompletions)
+    {
+        unsigned head = *q->cqHead;
+        unsigned tail = __atomic_load_n(q->cqTail, __ATOMIC_ACQUIRE);
+
+        if (head == tail)
+        {
+            if (got >= minCompletions)
+                break;
+
+            // polling mode spins on the completion ring instead of sleeping in the kernel
+            if ((q->flags & SM_ASYNC_POLL) && q->toSubmit == 0)
+                continue;
+
+            int entered = ringEnter(q, q->toSubmit, minCompletions - got, IORING_ENTER_GETEVENTS);
+            if (entered > 0)
+                q->toSubmit -= entered;
+            if (entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                break;
+            continue;
+        }
+
+        struct io_uring_cqe *cqe = &q->cqes[head & *q->cqMask];
+        int slot = (int)cqe->user_data;
+        int res = cqe->res;
+        SM_AsyncRequest *req = &q->requests[slot];
+
+        __atomic_store_n(q->cqHead, head + 1, __ATOMIC_RELEASE);
+
+        RC result = (res == q->info->pageSize) ? RC_OK : (req->isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE);
+
+        // the ring did the transfer, no readv/writev call of ours to count
+        countTransfer(q->info, req->isWrite, res > 0 ? res : 0, 0);
+
+        // short transfers and O_DIRECT refusals are finished on the synchronous path
+        if (result != RC_OK && (res >= 0 || res == -EINVAL))
+            result = transferOne(q->info, req->pageNum, req->memPage, req->isWrite);
+
+        completions[got].cookie = req->cookie;
+        completions[got].pageNum = req->pageNum;
+        completions[got].result = result;
+        got++;
+
+        pthread_mutex_lock(&q->lock);
+        q->freeSlots[q->numFree++] = slot;
+        pthread_mutex_unlock(&q->lock);
+    }
+
+    return got;
+}
+
+static int reapThreads(SM_AsyncQueue *q, SM_Completion *completions, int maxCompletions, int minCompletions)
+{
+    int got = 0;
+
+    pthread_mutex_lock(&q->lock);
+    while (got < maxCompletions)
+    {
+        if (q->doneCount == 0)
+        {
+            if (got >= minCompletions)
+                break;
+
+            if (q->flags & SM_ASYNC_POLL)
+            {
+                pthread_mutex_unlock(&q->lock);
+                sched_yield();
+                pthread_mutex_lock(&q->lock);
+            }
+            else
+            {
+                pthread_cond_wait(&q->doneReady, &q->lock);
+            }
+            continue;
+        }
+
+        SM_AsyncDone *c = &q->done[q->doneHead];
+        completions[got].cookie = c->cookie;
+        completions[got].pageNum = c->pageNum;
+        completions[got].result = c->result;
+        got++;
+        q->freeSlots[q->numFree++] = c->slot;
+        q->doneHead = (q->doneHead + 1) % q->depth;
+        q->doneCount--;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return got;
+}
+
+int reapCompletions(SM_FileHandle *fHandle, SM_Completion *completions, int maxCompletions, int minCompletions)
+{
+    SM_AsyncQueue *q = getAsyncQueue(fHandle);
+
+    if (q == NULL || completions == NULL || maxCompletions <= 0)
+        return 0;
+
+    // never wait for more than is actually outstanding
+    pthread_mutex_lock(&q->lock);
+    int outstanding = q->depth - q->numFree;
+    pthread_mutex_unlock(&q->lock);
+
+    if (minCompletions > outstanding)
+        minCompletions = outstanding;
+    if (minCompletions > maxCompletions)
+        minCompletions = maxCompletions;
+
+    return (q->ringFd >= 0) ? reapRing(q, completions, maxCompletions, minCompletions)
+                            : reapThreads(q, completions, maxCompletions, minCompletions);
+}
+
+RC shutdownAsyncIO(SM_FileHandle *fHandle)
+{
+    SM_AsyncQueue *q = getAsyncQueue(fHandle);
+    SM_Completion drain[16];
+
+    if (q == NULL)
+        return RC_OK;
+
+    // let outstanding requests finish, their buffers belong to the caller
+    while (reapCompletions(fHandle, drain, 16, 16) > 0)
+        ;
+
+    pthread_mutex_lock(&q->lock);
+    q->stopping = 1;
+    pthread_cond_broadcast(&q->workReady);
+    pthread_mutex_unlock(&q->lock);
+
+    for (int i = 0; i < q->numWorkers; i++)
+        pthread_join(q->workers[i], NULL);
+
+    teardownRing(q);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->workReady);
+    pthread_cond_destroy(&q->doneReady);
+    freeAsyncQueue(q);
+
+    getFileInfo(fHandle)->async = NULL;
+    return RC_OK;
+}
+
+// tablespaces: one page file holding many relations. Page 0 is a root naming
+// the first page of the directory, a chain of pages that lists every relation
+// with the extents (runs of tablespace pages) holding its pages and the pages
+// freed inside it, then the free extents left behind by dropped relations. A
+// relation is opened as an SM_FileHandle whose page numbers are translated into
+// the tablespace file, so the block calls above work on it unchanged. Like the
+// header of a page file, the directory is written when extents or free pages
+// change; a relation growing inside its extents only marks it dirty, for the
+// next sync, close or directory write.
+#define SM_SPACE_MAGIC "SMTBLSPC"
+#define SM_SPACE_ROOT_MAGIC "SMTSROOT"
+
+typedef struct SM_Relation
+{
+    char name[SM_RELATION_NAME_MAX];
+    PageNumber numPages;
+    SM_Range *extents; // in relation page order, offset and length in tablespace pages
+    int numExtents;
+    int extentCap;
+    SM_Range *freePages; // freed relation pages, sorted by offset; allocatePage reuses them
+    int numFree;
+    int freeCap;
+    SM_FileHandle **handles; // every open handle, growth updates their totalNumPages
+    int openHandles;
+    int handleCap;
+} SM_Relation;
+
+typedef struct SM_TablespaceInfo
+{
+    SM_FileHandle file;
+    SM_Relation **relations;
+    int numRelations;
+    int relationCap;
+    SM_Range *freeExtents; // sorted by offset
+    int numFree;
+    int freeCap;
+    PageNumber *dirPages; // the directory chain the root names; 0 leads it only in a pre-root tablespace
+    int numDirPages;
+    int dirPageCap;
+    int dirDirty; // a relation size changed since the directory was written
+    pthread_mutex_t lock; // relations, extents and directory; never held across relation I/O
+} SM_TablespaceInfo;
+
+// head of every directory page, the directory bytes follow it; on the root,
+// next is the first directory page and bytes is 0
+typedef struct SM_DirPage
+{
+    char magic[8];
+    PageNumber next; // -1 on the last page
+    int bytes;
+    int unused;
+} SM_DirPage;
+
+// one relation in the directory, followed by its extents and its free pages
+typedef struct SM_DirEntry
+{
+    char name[SM_RELATION_NAME_MAX];
+    PageNumber numPages;
+    int numExtents;
+    int numFree; // zero in directories written before relations freed pages
+} SM_DirEntry;
+
+static SM_TablespaceInfo *getSpaceInfo(SM_Tablespace *space)
+{
+    return (SM_TablespaceInfo *)space->mgmtInfo;
+}
+
+static SM_FileHandle *spaceFile(SM_FileHandle *fHandle)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || getFileInfo(fHandle)->space == NULL)
+        return fHandle;
+
+    return &getFileInfo(fHandle)->space->file;
+}
+
+static PageNumber relationCapacity(SM_Relation *relation)
+{
+    PageNumber pages = 0;
+
+    for (int i = 0; i < relation->numExtents; i++)
+        pages += relation->extents[i].length;
+
+    return pages;
+}
+
+static PageNumber relationFreePages(SM_Relation *relation)
+{
+    PageNumber pages = 0;
+
+    for (int i = 0; i < relation->numFree; i++)
+        pages += relation->freePages[i].length;
+
+    return pages;
+}
+
+// tablespace page of a relation page and how many pages follow it in the same
+// extent, -1 past the last extent
+static PageNumber translatePage(SM_Relation *relation, PageNumber pageNum, PageNumber *run)
+{
+    for (int i = 0; i < relation->numExtents; i++)
+    {
+        if (pageNum < relation->extents[i].length)
+        {
+            *run = relation->extents[i].length - pageNum;
+            return relation->extents[i].offset + pageNum;
+        }
+        pageNum -= relation->extents[i].length;
+    }
+
+    *run = 0;
+    return -1;
+}
+
+static SM_Relation *findRelation(SM_TablespaceInfo *ts, const char *name, int *index)
+{
+    for (int i = 0; i < ts->numRelations; i++)
+    {
+        if (strcmp(ts->relations[i]->name, name) == 0)
+        {
+            if (index != NULL)
+                *index = i;
+            return ts->relations[i];
+        }
+    }
+
+    return NULL;
+}
+
+static size_t directoryBytes(SM_TablespaceInfo *ts)
+{
+    size_t bytes = 2 * sizeof(int) + ts->numFree * sizeof(SM_Range);
+
+    for (int i = 0; i < ts->numRelations; i++)
+        bytes += sizeof(SM_DirEntry) + (ts->relations[i]->numExtents + ts->relations[i]->numFree) * sizeof(SM_Range);
+
+    return bytes;
+}
+
+// pages for extents and directory come from the free extents first, otherwise
+// from the end of the file; reused pages are zeroed if asked to
+static RC allocSpacePages(SM_TablespaceInfo *ts, PageNumber length, int zero, PageNumber *start)
+{
+    *start = takeRange(ts->freeExtents, &ts->numFree, length);
+
+    if (*start < 0)
+    {
+        *start = ts->file.totalNumPages;
+        return ensureCapacity(*start + length, &ts->file);
+    }
+
+    SM_PageHandle zeros[SM_READAHEAD_MAX];
+    for (int i = 0; i < SM_READAHEAD_MAX; i++)
+        zeros[i] = (SM_PageHandle)zeroPage;
+
+    for (PageNumber done = 0; zero && done < length; done += SM_READAHEAD_MAX)
+    {
+        int batch = (length - done < SM_READAHEAD_MAX) ? (int)(length - done) : SM_READAHEAD_MAX;
+        RC result = writeBlocks(*start + done, batch, &ts->file, zeros);
+
+        if (result != RC_OK)
+            return result;
+    }
+
+    return RC_OK;
+}
+
+// the directory is never overwritten: it goes to newly allocated pages, and
+// then the root on page 0 is switched to name them. The old chain is listed as
+// free in the new directory and is only handed out once the root has moved.
+// The root's fields sit in its first sector, which the disk writes whole.
+static RC writeSpaceDirectory(SM_TablespaceInfo *ts)
+{
+    int pageSize = getPageSize(&ts->file);
+    size_t perPage = pageSize - sizeof(SM_DirPage);
+    // taking pages never adds a free range, so this bounds the new directory
+    size_t bound = directoryBytes(ts) + ts->numDirPages * sizeof(SM_Range);
+    int numPages = (int)((bound + perPage - 1) / perPage);
+    int taken = 0;
+
+    PageNumber *chain = malloc(numPages * sizeof(PageNumber));
+    SM_Range *spare = malloc((ts->numFree + ts->numDirPages + 1) * sizeof(SM_Range));
+    char *blob = malloc(bound);
+    char *page = calloc(1, pageSize);
+    RC result = (chain == NULL || spare == NULL || blob == NULL || page == NULL) ? RC_MEMORY_ALLOCATION_FAILED : RC_OK;
+
+    while (result == RC_OK && taken < numPages)
+    {
+        result = allocSpacePages(ts, 1, 0, &chain[taken]);
+        if (result == RC_OK)
+            taken++;
+    }
+
+    // the free list as it is once the root has moved; the cap is never reached, so nothing is lost
+    int numSpare = 0, spareCap = ts->numFree + ts->numDirPages + 1;
+    if (result == RC_OK)
+    {
+        if (ts->numFree > 0)
+            memcpy(spare, ts->freeExtents, ts->numFree * sizeof(SM_Range));
+        numSpare = ts->numFree;
+        for (int i = 0; i < ts->numDirPages; i++)
+        {
+            if (ts->dirPages[i] != 0)
+                releaseRange(&spare, &numSpare, &spareCap, ts->dirPages[i], 1);
+        }
+    }
+
+    size_t bytes = 2 * sizeof(int);
+    if (result == RC_OK)
+    {
+        char *pos = blob;
+
+        memcpy(pos, &ts->numRelations, sizeof(int));
+        memcpy(pos + sizeof(int), &numSpare, sizeof(int));
+        pos += 2 * sizeof(int);
+
+        for (int i = 0; i < ts->numRelations; i++)
+        {
+            SM_Relation *relation = ts->relations[i];
+            SM_DirEntry entry = {.numPages = relation->numPages, .numExtents = relation->numExtents, .numFree = relation->numFree};
+
+            memcpy(entry.name, relation->name, SM_RELATION_NAME_MAX);
+            memcpy(pos, &entry, sizeof(entry));
+            pos += sizeof(entry);
+            if (relation->numExtents > 0)
+                memcpy(pos, relation->extents, relation->numExtents * sizeof(SM_Range));
+            pos += relation->numExtents * sizeof(SM_Range);
+            if (relation->numFree > 0)
+                memcpy(pos, relation->freePages, relation->numFree * sizeof(SM_Range));
+            pos += relation->numFree * sizeof(SM_Range);
+        }
+
+        if (numSpare > 0)
+            memcpy(pos, spare, numSpare * sizeof(SM_Range));
+        bytes = pos + numSpare * sizeof(SM_Range) - blob;
+    }
+
+    size_t done = 0;
+    for (int i = 0; i < numPages && result == RC_OK; i++)
+    {
+        SM_DirPage *head = (SM_DirPage *)page;
+        size_t chunk = (bytes - done < perPage) ? bytes - done : perPage;
+
+        memcpy(head->magic, SM_SPACE_MAGIC, sizeof(head->magic));
+        head->next = (i + 1 < numPages) ? chain[i + 1] : -1;
+        head->bytes = (int)chunk;
+        memcpy(page + sizeof(SM_DirPage), blob + done, chunk);
+        done += chunk;
+
+        result = writeBlock(chain[i], &ts->file, page);
+    }
+
+    // a file that asks for durability has the chain on disk before the root names it
+    SM_FileInfo *info = getFileInfo(&ts->file);
+    if (result == RC_OK && info->header->durability != SM_SYNC_NONE)
+        result = syncWholeFile(info);
+
+    if (result == RC_OK)
+    {
+        SM_DirPage *root = (SM_DirPage *)page;
+
+        memset(page, 0, pageSize);
+        memcpy(root->magic, SM_SPACE_ROOT_MAGIC, sizeof(root->magic));
+        root->next = chain[0];
+        result = writeBlock(0, &ts->file, page);
+    }
+
+    if (result == RC_OK)
+    {
+        free(ts->freeExtents);
+        free(ts->dirPages);
+        ts->freeExtents = spare;
+        ts->numFree = numSpare;
+        ts->freeCap = spareCap;
+        ts->dirPages = chain;
+        ts->numDirPages = ts->dirPageCap = numPages;
+        ts->dirDirty = 0;
+    }
+    else
+    {
+        // the old chain is still the directory, the new pages go back
+        for (int i = 0; i < taken; i++)
+            releaseRange(&ts->freeExtents, &ts->numFree, &ts->freeCap, chain[i], 1);
+        free(chain);
+        free(spare);
+    }
+
+    free(blob);
+    free(page);
+    return result;
+}
+
+static void freeRelation(SM_Relation *relation)
+{
+    free(relation->extents);
+    free(relation->freePages);
+    free(relation->handles);
+    free(relation);
+}
+
+static void freeSpaceInfo(SM_TablespaceInfo *ts)
+{
+    for (int i = 0; i < ts->numRelations; i++)
+        freeRelation(ts->relations[i]);
+
+    pthread_mutex_destroy(&ts->lock);
+    free(ts->relations);
+    free(ts->freeExtents);
+    free(ts->dirPages);
+    free(ts);
+}
+
+static int addRelation(SM_TablespaceInfo *ts, SM_Relation *relation)
+{
+    if (ts->numRelations == ts->relationCap)
+    {
+        int cap = ts->relationCap > 0 ? ts->relationCap * 2 : 16;
+        SM_Relation **relations = realloc(ts->relations, cap * sizeof(SM_Relation *));
+
+        if (relations == NULL)
+            return -1;
+        ts->relations = relations;
+        ts->relationCap = cap;
+    }
+
+    ts->relations[ts->numRelations++] = relation;
+    return 0;
+}
+
+static int rangesOverlap(SM_Range a, SM_Range b)
+{
+    return a.offset < b.offset + b.length && b.offset < a.offset + a.length;
+}
+
+// whether any page of the range belongs to a relation or the directory
+static int spaceRangeInUse(SM_TablespaceInfo *ts, SM_Range range)
+{
+    for (int i = 0; i < ts->numRelations; i++)
+    {
+        for (int j = 0; j < ts->relations[i]->numExtents; j++)
+        {
+            if (rangesOverlap(range, ts->relations[i]->extents[j]))
+                return 1;
+        }
+    }
+
+    for (int i = 0; i < ts->numDirPages; i++)
+    {
+        if (ts->dirPages[i] >= range.offset && ts->dirPages[i] < range.offset + range.length)
+            return 1;
+    }
+
+    return 0;
+}
+
+// parse the directory bytes; every count is checked against what is left
+static RC parseSpaceDirectory(SM_TablespaceInfo *ts, const char *blob, size_t bytes)
+{
+    const char *pos = blob, *end = blob + bytes;
+    int numRelations, numFree;
+
+    if (bytes < 2 * sizeof(int))
+        return RC_INVALID_PAGE_FILE;
+
+    memcpy(&numRelations, pos, sizeof(int));
+    memcpy(&numFree, pos + sizeof(int), sizeof(int));
+    pos += 2 * sizeof(int);
+
+    for (int i = 0; i < numRelations; i++)
+    {
+        SM_DirEntry entry;
+
+        if ((size_t)(end - pos) < sizeof(entry))
+            return RC_INVALID_PAGE_FILE;
+        memcpy(&entry, pos, sizeof(entry));
+        pos += sizeof(entry);
+
+        if (entry.numExtents < 0 || entry.numFree < 0 ||
+            (size_t)(end - pos) < ((size_t)entry.numExtents + entry.numFree) * sizeof(SM_Range) ||
+            memchr(entry.name, '\0', SM_RELATION_NAME_MAX) == NULL)
+            return RC_INVALID_PAGE_FILE;
+
+        SM_Relation *relation = calloc(1, sizeof(SM_Relation));
+        if (relation == NULL || addRelation(ts, relation) != 0)
+        {
+            free(relation);
+            return RC_MEMORY_ALLOCATION_FAILED;
+        }
+
+        memcpy(relation->name, entry.name, SM_RELATION_NAME_MAX);
+        relation->numPages = entry.numPages;
+        relation->extents = malloc((entry.numExtents > 0 ? entry.numExtents : 1) * sizeof(SM_Range));
+        if (relation->extents == NULL)
+            return RC_MEMORY_ALLOCATION_FAILED;
+
+        memcpy(relation->extents, pos, entry.numExtents * sizeof(SM_Range));
+        relation->numExtents = entry.numExtents;
+        relation->extentCap = entry.numExtents > 0 ? entry.numExtents : 1;
+        pos += entry.numExtents * sizeof(SM_Range);
+
+        if (relation->numPages < 0 || relation->numPages > relationCapacity(relation))
+            return RC_INVALID_PAGE_FILE;
+
+        // written sorted and disjoint, anything else is damage
+        PageNumber previousEnd = 0;
+        for (int j = 0; j < entry.numFree; j++)
+        {
+            SM_Range range;
+
+            memcpy(&range, pos + j * sizeof(SM_Range), sizeof(range));
+            if (range.offset < previousEnd || range.length <= 0 || range.offset > relation->numPages - range.length)
+                return RC_INVALID_PAGE_FILE;
+            releaseRange(&relation->freePages, &relation->numFree, &relation->freeCap, range.offset, range.length);
+            previousEnd = range.offset + range.length;
+        }
+        pos += entry.numFree * sizeof(SM_Range);
+    }
+
+    if (numFree < 0 || (size_t)(end - pos) < numFree * sizeof(SM_Range))
+        return RC_INVALID_PAGE_FILE;
+
+    // free space is sorted and disjoint, inside the file and past the root,
+    // and used by neither a relation nor the directory
+    PageNumber previousEnd = 1;
+    for (int i = 0; i < numFree; i++)
+    {
+        SM_Range range;
+
+        memcpy(&range, pos + i * sizeof(SM_Range), sizeof(range));
+        if (range.offset < previousEnd || range.length <= 0 ||
+            range.offset > ts->file.totalNumPages - range.length || spaceRangeInUse(ts, range))
+            return RC_INVALID_PAGE_FILE;
+        releaseRange(&ts->freeExtents, &ts->numFree, &ts->freeCap, range.offset, range.length);
+        previousEnd = range.offset + range.length;
+    }
+
+    return RC_OK;
+}
+
+static RC readSpaceDirectory(SM_TablespaceInfo *ts)
+{
+    int pageSize = getPageSize(&ts->file);
+    char *page = malloc(pageSize);
+    char *blob = NULL;
+    size_t bytes = 0;
+    RC result = RC_OK;
+
+    ts->dirPageCap = 4;
+    ts->dirPages = malloc(ts->dirPageCap * sizeof(PageNumber));
+
+    if (page == NULL || ts->dirPages == NULL)
+    {
+        free(page);
+        return RC_MEMORY_ALLOCATION_FAILED;
+    }
+
+    // the root names the chain; a tablespace from before the root began its chain on page 0
+    PageNumber first = 0;
+    if (readBlock(0, &ts->file, page) != RC_OK)
+        result = RC_INVALID_PAGE_FILE;
+    else if (memcmp(((SM_DirPage *)page)->magic, SM_SPACE_ROOT_MAGIC, sizeof(((SM_DirPage *)page)->magic)) == 0)
+        first = ((SM_DirPage *)page)->next;
+
+    // a chain longer than the file must loop somewhere
+    for (PageNumber next = first; next != -1 && result == RC_OK; )
+    {
+        SM_DirPage *head = (SM_DirPage *)page;
+
+        if (next < 0 || next >= ts->file.totalNumPages || ts->numDirPages >= ts->file.totalNumPages ||
+            readBlock(next, &ts->file, page) != RC_OK ||
+            memcmp(head->magic, SM_SPACE_MAGIC, sizeof(head->magic)) != 0 ||
+            head->bytes < 0 || (size_t)head->bytes > pageSize - sizeof(SM_DirPage))
+        {
+            result = RC_INVALID_PAGE_FILE;
+            break;
+        }
+
+        if (ts->numDirPages == ts->dirPageCap)
+        {
+            PageNumber *pages = realloc(ts->dirPages, ts->dirPageCap * 2 * sizeof(PageNumber));
+
+            if (pages == NULL)
+            {
+                result = RC_MEMORY_ALLOCATION_FAILED;
+                break;
+            }
+            ts->dirPages = pages;
+            ts->dirPageCap *= 2;
+        }
+
+        char *grown = realloc(blob, bytes + head->bytes + 1);
+        if (grown == NULL)
+        {
+            result = RC_MEMORY_ALLOCATION_FAILED;
+            break;
+        }
+        blob = grown;
+
+        memcpy(blob + bytes, page + sizeof(SM_DirPage), head->bytes);
+        bytes += head->bytes;
+        ts->dirPages[ts->numDirPages++] = next;
+        next = head->next;
+    }
+
+    if (result == RC_OK)
+        result = parseSpaceDirectory(ts, blob, bytes);
+
+    free(blob);
+    free(page);
+    return result;
+}
+
+RC createTablespace(char *fileName)
+{
+    SM_Tablespace space;
+    RC result = createPageFile(fileName);
+
+    if (result != RC_OK)
+        return result;
+
+    SM_TablespaceInfo *ts = calloc(1, sizeof(SM_TablespaceInfo));
+    if (ts == NULL)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    pthread_mutex_init(&ts->lock, NULL);
+    ts->dirPageCap = 4;
+    ts->dirPages = malloc(ts->dirPageCap * sizeof(PageNumber));
+    if (ts->dirPages == NULL)
+    {
+        freeSpaceInfo(ts);
+        return RC_MEMORY_ALLOCATION_FAILED;
+    }
+
+    space.fileName = fileName;
+    space.mgmtInfo = ts;
+
+    if ((result = openPageFile(fileName, &ts->file)) != RC_OK)
+    {
+        freeSpaceInfo(ts);
+        return result;
+    }
+
+    return closeTablespace(&space);
+}
+
+RC openTablespace(char *fileName, SM_Tablespace *space)
+{
+    SM_TablespaceInfo *ts = calloc(1, sizeof(SM_TablespaceInfo));
+
+    if (space == NULL || ts == NULL)
+    {
+        free(ts);
+        return RC_MEMORY_ALLOCATION_FAILED;
+    }
+
+    pthread_mutex_init(&ts->lock, NULL);
+
+    RC result = openPageFile(fileName, &ts->file);
+    if (result != RC_OK)
+    {
+        freeSpaceInfo(ts);
+        return result;
+    }
+
+    if ((result = readSpaceDirectory(ts)) != RC_OK)
+    {
+        closePageFile(&ts->file);
+        freeSpaceInfo(ts);
+        return result;
+    }
+
+    space->fileName = fileName;
+    space->mgmtInfo = ts;
+    return RC_OK;
+}
+
+RC closeTablespace(SM_Tablespace *space)
+{
+    if (space == NULL || space->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_TablespaceInfo *ts = getSpaceInfo(space);
+
+    for (int i = 0; i < ts->numRelations; i++)
+    {
+        if (ts->relations[i]->openHandles > 0)
+            return RC_RELATION_IN_USE;
+    }
+
+    RC result = writeSpaceDirectory(ts);
+    RC closed = closePageFile(&ts->file);
+
+    freeSpaceInfo(ts);
+    space->mgmtInfo = NULL;
+    return (result != RC_OK) ? result : closed;
+}
+
+RC createRelation(SM_Tablespace *space, char *name)
+{
+    if (space == NULL || space->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (name == NULL || name[0] == '\0' || strlen(name) >= SM_RELATION_NAME_MAX)
+        return RC_INVALID_ARGUMENT;
+
+    SM_TablespaceInfo *ts = getSpaceInfo(space);
+    RC result = RC_OK;
+
+    pthread_mutex_lock(&ts->lock);
+
+    if (findRelation(ts, name, NULL) != NULL)
+        result = RC_RELATION_EXISTS;
+    else
+    {
+        SM_Relation *relation = calloc(1, sizeof(SM_Relation));
+
+        if (relation == NULL || addRelation(ts, relation) != 0)
+        {
+            free(relation);
+            result = RC_MEMORY_ALLOCATION_FAILED;
+        }
+        else
+            strcpy(relation->name, name);
+    }
+
+    pthread_mutex_unlock(&ts->lock);
+
+    if (result != RC_OK)
+        return result;
+
+    // like a page file, a new relation starts out with one empty page
+    SM_FileHandle fHandle;
+
+    if ((result = openRelation(space, name, &fHandle)) == RC_OK)
+    {
+        result = ensureCapacity(1, &fHandle);
+        closePageFile(&fHandle);
+    }
+
+    return result;
+}
+
+RC dropRelation(SM_Tablespace *space, char *name)
+{
+    if (space == NULL || space->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_TablespaceInfo *ts = getSpaceInfo(space);
+    int index;
+
+    pthread_mutex_lock(&ts->lock);
+
+    SM_Relation *relation = (name == NULL) ? NULL : findRelation(ts, name, &index);
+    RC result = (relation == NULL) ? RC_RELATION_NOT_FOUND : (relation->openHandles > 0) ? RC_RELATION_IN_USE : RC_OK;
+
+    if (result == RC_OK)
+    {
+        for (int i = 0; i < relation->numExtents; i++)
+            releaseRange(&ts->freeExtents, &ts->numFree, &ts->freeCap, relation->extents[i].offset, relation->extents[i].length);
+
+        memmove(ts->relations + index, ts->relations + index + 1, (ts->numRelations - index - 1) * sizeof(SM_Relation *));
+        ts->numRelations--;
+        freeRelation(relation);
+
+        result = writeSpaceDirectory(ts);
+    }
+
+    pthread_mutex_unlock(&ts->lock);
+    return result;
+}
+
+RC openRelation(SM_Tablespace *space, char *name, SM_FileHandle *fHandle)
+{
+    if (space == NULL || space->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_TablespaceInfo *ts = getSpaceInfo(space);
+    SM_FileInfo *info = calloc(1, sizeof(SM_FileInfo));
+    RC result = RC_OK;
+
+    if (info == NULL)
+        return RC_MEMORY_ALLOCATION_FAILED;
+
+    pthread_mutex_lock(&ts->lock);
+
+    SM_Relation *relation = (name == NULL) ? NULL : findRelation(ts, name, NULL);
+
+    if (relation == NULL)
+        result = RC_RELATION_NOT_FOUND;
+    else if (relation->openHandles == relation->handleCap)
+    {
+        int cap = relation->handleCap > 0 ? relation->handleCap * 2 : 4;
+        SM_FileHandle **handles = realloc(relation->handles, cap * sizeof(SM_FileHandle *));
+
+        if (handles == NULL)
+            result = RC_MEMORY_ALLOCATION_FAILED;
+        else
+        {
+            relation->handles = handles;
+            relation->handleCap = cap;
+        }
+    }
+
+    if (result == RC_OK)
+    {
+        info->space = ts;
+        info->relation = relation;
+        info->pageSize = getPageSize(&ts->file);
+        relation->handles[relation->openHandles++] = fHandle;
+
+        fHandle->fileName = relation->name;
+        fHandle->totalNumPages = relation->numPages;
+        fHandle->curPagePos = 0;
+        fHandle->mgmtInfo = info;
+    }
+
+    pthread_mutex_unlock(&ts->lock);
+
+    if (result != RC_OK)
+        free(info);
+    return result;
+}
+
+RC getTablespacePage(SM_FileHandle *fHandle, PageNumber pageNum, PageNumber *spacePage)
+{
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || getFileInfo(fHandle)->relation == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_FileInfo *info = getFileInfo(fHandle);
+    PageNumber run;
+
+    pthread_mutex_lock(&info->space->lock);
+    *spacePage = (pageNum < 0 || pageNum >= info->relation->numPages) ? -1 : translatePage(info->relation, pageNum, &run);
+    pthread_mutex_unlock(&info->space->lock);
+
+    return (*spacePage < 0) ? RC_READ_NON_EXISTING_PAGE : RC_OK;
+}
+
+// like closePageFile writes the header, closing a relation writes a directory it left dirty
+static RC closeRelation(SM_FileHandle *fHandle)
+{
+    SM_FileInfo *info = getFileInfo(fHandle);
+    SM_Relation *relation = info->relation;
+    RC result = RC_OK;
+
+    pthread_mutex_lock(&info->space->lock);
+    if (info->space->dirDirty)
+        result = writeSpaceDirectory(info->space);
+
+    for (int i = 0; i < relation->openHandles; i++)
+    {
+        if (relation->handles[i] == fHandle)
+        {
+            relation->handles[i] = relation->handles[--relation->openHandles];
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&info->space->lock);
+    free(info);
+
+    fHandle->fileName = NULL;
+    fHandle->curPagePos = 0;
+    fHandle->totalNumPages = 0;
+    fHandle->mgmtInfo = NULL;
+    return result;
+}
+
+// split the run at extent boundaries, each piece is one call on the tablespace
+// file; extents never move, so only the lookup needs the tablespace lock
+static RC relationIO(SM_FileHandle *fHandle, PageNumber startPage, int count, SM_PageHandle pages[], int isWrite)
+{
+    SM_FileInfo *info = getFileInfo(fHandle);
+
+    for (int done = 0; done < count; )
+    {
+        PageNumber run;
+
+        pthread_mutex_lock(&info->space->lock);
+        PageNumber spacePage = translatePage(info->relation, startPage + done, &run);
+        pthread_mutex_unlock(&info->space->lock);
+
+        if (spacePage < 0)
+            return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+
+        int batch = (run < count - done) ? (int)run : count - done;
+        RC result = isWrite ? writeBlocks(spacePage, batch, &info->space->file, pages + done)
+                            : readBlocks(spacePage, batch, &info->space->file, pages + done);
+        if (result != RC_OK)
+            return result;
+
+        done += batch;
+    }
+
+    fHandle->curPagePos = startPage + count - 1;
+    return RC_OK;
+}
+
+// a new size reaches every open handle on the relation right away, the directory later
+static void setRelationSize(SM_TablespaceInfo *ts, SM_Relation *relation, PageNumber numPages)
+{
+    relation->numPages = numPages;
+
+    for (int i = 0; i < relation->openHandles; i++)
+        relation->handles[i]->totalNumPages = numPages;
+
+    ts->dirDirty = 1;
+}
+
+// writes the directory if a relation grew inside its extents since it was last written
+static RC flushSpaceDirectory(SM_TablespaceInfo *ts)
+{
+    RC result = RC_OK;
+
+    pthread_mutex_lock(&ts->lock);
+    if (ts->dirDirty)
+        result = writeSpaceDirectory(ts);
+    pthread_mutex_unlock(&ts->lock);
+
+    return result;
+}
+
+// relations grow in extents that double like those of a page file; the
+// directory is written with every new extent so a crash loses at most the
+// size reached inside the last one
+static RC growRelation(SM_FileHandle *fHandle, PageNumber numPages)
+{
+    SM_FileInfo *info = getFileInfo(fHandle);
+    SM_TablespaceInfo *ts = info->space;
+    SM_Relation *relation = info->relation;
+    RC result = RC_OK;
+    int added = 0;
+
+    pthread_mutex_lock(&ts->lock);
+
+    PageNumber capacity = relationCapacity(relation);
+
+    while (capacity < numPages && result == RC_OK)
+    {
+        PageNumber length = capacity < SM_MIN_EXTENT ? SM_MIN_EXTENT : capacity;
+        PageNumber start;
+
+        length = length > SM_MAX_EXTENT ? SM_MAX_EXTENT : length;
+        length = length < numPages - capacity ? numPages - capacity : length;
+
+        if ((result = allocSpacePages(ts, length, 1, &start)) != RC_OK)
+            break;
+
+        SM_Range *last = relation->numExtents > 0 ? &relation->extents[relation->numExtents - 1] : NULL;
+
+        if (last != NULL && last->offset + last->length == start)
+            last->length += length;
+        else if (insertRange(&relation->extents, &relation->numExtents, &relation->extentCap,
+                             relation->numExtents, start, length) != 0)
+        {
+            releaseRange(&ts->freeExtents, &ts->numFree, &ts->freeCap, start, length);
+            result = RC_MEMORY_ALLOCATION_FAILED;
+        }
+
+        capacity += length;
+        added = 1;
+    }
+
+    // another handle may have grown the relation past this size already
+    if (result == RC_OK && numPages > relation->numPages)
+        setRelationSize(ts, relation, numPages);
+    if (result == RC_OK && added)
+        result = writeSpaceDirectory(ts);
+
+    pthread_mutex_unlock(&ts->lock);
+
+    if (result == RC_OK)
+        fHandle->curPagePos = numPages - 1;
+    return result;
+}
+
+// a freed page is handed out again before the relation grows, zeroed like an appended one
+static RC allocateRelationPage(SM_FileHandle *fHandle, PageNumber *pageNum)
+{
+    SM_FileInfo *info = getFileInfo(fHandle);
+    SM_TablespaceInfo *ts = info->space;
+    SM_Relation *relation = info->relation;
+    PageNumber run;
+
+    pthread_mutex_lock(&ts->lock);
+
+    PageNumber page = takeRange(relation->freePages, &relation->numFree, 1);
+    RC result = RC_OK;
+
+    if (page >= 0)
+    {
+        result = writeBlock(translatePage(relation, page, &run), &ts->file, (SM_PageHandle)zeroPage);
+
+        if (result != RC_OK)
+            releaseRange(&relation->freePages, &relation->numFree, &relation->freeCap, page, 1);
+        else
+            result = writeSpaceDirectory(ts);
+    }
+
+    pthread_mutex_unlock(&ts->lock);
+
+    if (page < 0)
+    {
+        result = appendEmptyBlock(fHandle);
+        page = fHandle->totalNumPages - 1;
+    }
+
+    if (result == RC_OK)
+        *pageNum = page;
+    return result;
+}
+
+static RC freeRelationPage(SM_FileHandle *fHandle, PageNumber pageNum)
+{
+    SM_FileInfo *info = getFileInfo(fHandle);
+    SM_TablespaceInfo *ts = info->space;
+    SM_Relation *relation = info->relation;
+    RC result = RC_OK;
+    int isFree = 0;
+
+    pthread_mutex_lock(&ts->lock);
+
+    for (int i = 0; i < relation->numFree; i++)
+        isFree |= pageNum >= relation->freePages[i].offset && pageNum - relation->freePages[i].offset < relation->freePages[i].length;
+
+    if (pageNum < 0 || pageNum >= relation->numPages)
+        result = RC_READ_NON_EXISTING_PAGE;
+    else if (!isFree)
+    {
+        releaseRange(&relation->freePages, &relation->numFree, &relation->freeCap, pageNum, 1);
+        result = writeSpaceDirectory(ts);
+    }
+
+    pthread_mutex_unlock(&ts->lock);
+    return result;
 }
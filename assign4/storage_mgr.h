@@ -8,13 +8,71 @@
  ************************************************************/
 typedef struct SM_FileHandle {
 	char *fileName;
-	int totalNumPages;
-	int curPagePos;
+	PageNumber totalNumPages;
+	PageNumber curPagePos;
 	void *mgmtInfo;
 } SM_FileHandle;
 
 typedef char* SM_PageHandle;
 
+/* a single page file holding many named relations, see openTablespace */
+typedef struct SM_Tablespace {
+	char *fileName;
+	void *mgmtInfo;
+} SM_Tablespace;
+
+/* longest relation name, terminating NUL included */
+#define SM_RELATION_NAME_MAX 64
+
+/* one finished asynchronous request, as returned by reapCompletions */
+typedef struct SM_Completion {
+	void *cookie;
+	PageNumber pageNum;
+	RC result;
+} SM_Completion;
+
+/* initAsyncIO flags: busy-poll for completions instead of sleeping,
+ * and skip io_uring in favour of the worker-thread fallback */
+#define SM_ASYNC_POLL 1
+#define SM_ASYNC_THREADS 2
+
+/* page buffers handed to a direct-I/O handle should start on this boundary,
+ * unaligned ones are staged through a bounce buffer */
+#define SM_IO_ALIGNMENT 4096
+
+/* durability policy of a page file, kept in its header:
+ * SM_SYNC_NONE         leave write-back to the kernel
+ * SM_SYNC_ON_FLUSH     syncPageFile (called by forceFlushPool) fdatasyncs
+ * SM_SYNC_PERIODIC     a background thread syncs every param ms (default 1000)
+ * SM_SYNC_WRITE_BEHIND sync_file_range starts write-back every param pages
+ *                      (default 64), syncPageFile then waits for the rest */
+typedef enum SM_Durability {
+	SM_SYNC_NONE = 0,
+	SM_SYNC_ON_FLUSH = 1,
+	SM_SYNC_PERIODIC = 2,
+	SM_SYNC_WRITE_BEHIND = 3
+} SM_Durability;
+
+/* latency histograms: bucket i counts calls that took [2^i, 2^(i+1)) ns,
+ * the last bucket also takes everything slower */
+#define SM_LATENCY_BUCKETS 32
+
+/* I/O accounting of one handle, see getFileStats */
+typedef struct SM_FileStats {
+	long long bytesRead; // moved from the file (or mapping) into memory
+	long long bytesWritten;
+	long long numReadCalls; // preadv/pwritev requests, header I/O included, retries not counted
+	long long numWriteCalls;
+	long long numSequential; // reads and writes starting right after the previous one
+	long long numRandom;
+	long long numSyncs; // fdatasync/msync rounds, from any policy or syncBlocks
+	long long syncNanos;
+	long long numWriteBehind; // sync_file_range rounds
+	long long writeBehindNanos;
+	long long readLatency[SM_LATENCY_BUCKETS]; // readBlock(s) calls
+	long long writeLatency[SM_LATENCY_BUCKETS]; // writeBlock(s) calls
+} SM_FileStats;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
@@ -25,19 +83,115 @@ extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
 
+/* page size is chosen per file when it is created: a power of two between
+ * SM_MIN_PAGE_SIZE and SM_MAX_PAGE_SIZE, createPageFile uses PAGE_SIZE;
+ * every page buffer handed to a handle must hold getPageSize bytes */
+#define SM_MIN_PAGE_SIZE 4096
+#define SM_MAX_PAGE_SIZE 65536
+
+extern RC createPageFileSized (char *fileName, int pageSize, PageNumber segmentPages);
+extern int getPageSize (SM_FileHandle *fHandle);
+
+/* sequential readahead: reads continuing the previous one are served from a
+ * small per-handle staging cache filled in windows of SM_READAHEAD_MIN pages
+ * doubling up to maxPages (default SM_READAHEAD_MAX), 0 turns it off */
+#define SM_READAHEAD_MIN 4
+#define SM_READAHEAD_MAX 32
+
+extern RC setReadahead (SM_FileHandle *fHandle, int maxPages);
+
+/* durability policy and I/O accounting: getLatencyPercentile returns the
+ * upper bound in ns of the bucket holding the given percentile (0-100) */
+extern RC setDurability (SM_FileHandle *fHandle, SM_Durability policy, int param);
+extern SM_Durability getDurability (SM_FileHandle *fHandle);
+extern RC syncPageFile (SM_FileHandle *fHandle);
+extern RC getFileStats (SM_FileHandle *fHandle, SM_FileStats *stats);
+extern RC resetFileStats (SM_FileHandle *fHandle);
+extern long long getLatencyPercentile (long long histogram[SM_LATENCY_BUCKETS], double percentile);
+extern void printFileStats (SM_FileHandle *fHandle);
+
+/* segmented page files: the pages are spread over fixed-size segment files
+ * "fileName", "fileName.1", "fileName.2", ... of segmentPages pages each;
+ * all other calls work unchanged, except openPageFileMapped which refuses them */
+extern RC createPageFileSegmented (char *fileName, PageNumber segmentPages);
+extern PageNumber getSegmentPages (SM_FileHandle *fHandle);
+
+/* compressed page files: every page is LZ-compressed into a slot of its own
+ * found through a page directory, readBlock decompresses it again; the
+ * directory is written with the header (closePageFile, syncBlocks, ...).
+ * Such files are never segmented, mapped, opened for direct I/O or used
+ * with initAsyncIO */
+extern RC createPageFileCompressed (char *fileName, int pageSize);
+extern int isCompressed (SM_FileHandle *fHandle);
+
+/* tablespaces: relations are named page ranges inside one page file that
+ * share its descriptor and its free space; openRelation hands out an
+ * SM_FileHandle on which the block calls work as on a page file of its own
+ * (setHolePunching, mapping and async I/O are refused). Each relation keeps
+ * its own list of freed pages for allocatePage. The directory is written
+ * to fresh pages and then named by a root on page 0, whenever an extent or
+ * a free list changes; growth inside the extents reaches it at syncBlocks,
+ * syncPageFile, closeRelation or closeTablespace. Every open handle on a
+ * relation sees the new totalNumPages, so a handle must stay where
+ * openRelation put it. I/O statistics are those of the tablespace file.
+ * getTablespacePage translates a relation page into the tablespace file. */
+extern RC createTablespace (char *fileName);
+extern RC openTablespace (char *fileName, SM_Tablespace *space);
+extern RC closeTablespace (SM_Tablespace *space);
+extern RC createRelation (SM_Tablespace *space, char *name);
+extern RC dropRelation (SM_Tablespace *space, char *name);
+extern RC openRelation (SM_Tablespace *space, char *name, SM_FileHandle *fHandle);
+extern RC getTablespacePage (SM_FileHandle *fHandle, PageNumber pageNum, PageNumber *spacePage);
+
+/* direct I/O (O_DIRECT), falls back to buffered I/O where unsupported */
+extern RC openPageFileDirect (char *fileName, SM_FileHandle *fHandle);
+extern int isDirectIO (SM_FileHandle *fHandle);
+
+/* memory-mapped page files: mapBlock hands out pointers straight into the
+ * mapping, valid until the handle is closed or the file grows past the
+ * reserved mapping (ensureCapacity/appendEmptyBlock may then move it).
+ * syncBlocks msyncs a range of pages, the mapped counterpart of forcePage.
+ * This mode is for direct callers only: the buffer pool keeps copying pages
+ * into its frames, since the kernel may write back a mapped page at any
+ * time, before the WAL covers it, and growth may move the mapping under
+ * pinned frames */
+extern RC openPageFileMapped (char *fileName, SM_FileHandle *fHandle);
+extern RC mapBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage);
+extern RC syncBlocks (PageNumber startPage, int count, SM_FileHandle *fHandle);
+
 /* reading blocks from disc */
-extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
-extern int getBlockPos (SM_FileHandle *fHandle);
+extern RC readBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern PageNumber getBlockPos (SM_FileHandle *fHandle);
 extern RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC readBlocks (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[]);
 
 /* writing blocks to a page file */
-extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlocks (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle pages[]);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
-extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC ensureCapacity (PageNumber numberOfPages, SM_FileHandle *fHandle);
+extern PageNumber getAllocatedBlocks (SM_FileHandle *fHandle);
+
+/* free-page map kept in the file header: freed pages are handed out again by
+ * allocatePage; with hole punching on, runs of at least minRunPages free pages
+ * give their disk blocks back (FALLOC_FL_PUNCH_HOLE) */
+extern RC allocatePage (SM_FileHandle *fHandle, PageNumber *pageNum);
+extern RC freePage (PageNumber pageNum, SM_FileHandle *fHandle);
+extern PageNumber getNumFreePages (SM_FileHandle *fHandle);
+extern RC setHolePunching (SM_FileHandle *fHandle, int minRunPages);
+
+/* asynchronous block I/O: at most queueDepth requests are outstanding, page
+ * buffers must stay valid until their completion has been reaped */
+extern RC initAsyncIO (SM_FileHandle *fHandle, int queueDepth, int flags);
+extern RC shutdownAsyncIO (SM_FileHandle *fHandle);
+extern int isAsyncRing (SM_FileHandle *fHandle);
+extern RC submitRead (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *cookie);
+extern RC submitWrite (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *cookie);
+extern int reapCompletions (SM_FileHandle *fHandle, SM_Completion *completions, int maxCompletions, int minCompletions);
 
 #endif
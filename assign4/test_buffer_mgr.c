@@ -0,0 +1,829 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTPF "test_bufpages.bin"
+
+#define NUM_FILE_PAGES 500
+#define NUM_FRAMES 64
+#define NUM_THREADS 8
+
+/* prototypes for test functions */
+static void testPageTable(void);
+static void testPoolFile(void);
+static void testPoolRelation(void);
+static void testLRUK(void);
+static void testLFU(void);
+static void testARC(void);
+static void testFailedLoad(void);
+static void testConcurrentPins(void);
+static void testPoolWriter(void);
+static void testPrefetch(void);
+static void testScanRing(void);
+
+/* main function running all tests */
+int
+main (void)
+{
+  testName = "";
+
+  initStorageManager();
+
+  testPageTable();
+  testPoolFile();
+  testPoolRelation();
+  testLRUK();
+  testLFU();
+  testARC();
+  testFailedLoad();
+  testConcurrentPins();
+  testPoolWriter();
+  testPrefetch();
+  testScanRing();
+
+  return 0;
+}
+
+/* every page carries its own number so a wrong frame lookup shows up */
+static void
+createNumberedFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph = (SM_PageHandle) calloc(PAGE_SIZE, 1);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  for (int i = 0; i < NUM_FILE_PAGES; i++)
+  {
+    sprintf(ph, "Page-%i", i);
+    TEST_CHECK(writeBlock (i, &fh, ph));
+  }
+  TEST_CHECK(closePageFile (&fh));
+  free(ph);
+}
+
+static int
+pageHolds(BM_PageHandle *h, PageNumber pageNum)
+{
+  char expected[32];
+
+  sprintf(expected, "Page-%lld", pageNum);
+  return h->pageNum == pageNum && strcmp(h->data, expected) == 0;
+}
+
+// random pins over a file much larger than the pool evict and reload pages many times
+static int
+randomPins(BM_BufferPool *bm, unsigned seed, int count)
+{
+  BM_PageHandle h;
+  int ok = 1;
+
+  for (int i = 0; i < count && ok; i++)
+  {
+    PageNumber pageNum = rand_r(&seed) % NUM_FILE_PAGES;
+
+    ok = pinPage(bm, &h, pageNum) == RC_OK && pageHolds(&h, pageNum) && unpinPage(bm, &h) == RC_OK;
+  }
+
+  return ok;
+}
+
+/* Hits, misses and evictions keep the page table in step with the frames */
+void
+testPageTable(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *other = MAKE_PAGE_HANDLE();
+
+  testName = "test page table lookups";
+
+  createNumberedFile();
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_CLOCK, NULL));
+  ASSERT_TRUE(randomPins(bm, 7, 5000), "every pin returns the requested page");
+
+  // a hit fills the handle even when it still points at another page
+  TEST_CHECK(pinPage (bm, h, 3));
+  TEST_CHECK(pinPage (bm, other, 4));
+  TEST_CHECK(pinPage (bm, other, 3));
+  ASSERT_TRUE((other->data == h->data && pageHolds(other, 3)), "hit returns the resident frame");
+  TEST_CHECK(unpinPage (bm, other));
+  other->pageNum = 4;
+  TEST_CHECK(unpinPage (bm, other));
+
+  // the frame stays in the table while pinned and leaves it once evicted
+  sprintf(h->data, "Page-%i", 3);
+  strcat(h->data, "!");
+  TEST_CHECK(markDirty (bm, h));
+  TEST_CHECK(unpinPage (bm, h));
+  ASSERT_ERROR(unpinPage (bm, h), "unpinning an unpinned page should fail");
+  for (PageNumber pageNum = 100; pageNum < 100 + 2 * NUM_FRAMES; pageNum++)
+  {
+    TEST_CHECK(pinPage (bm, h, pageNum));
+    TEST_CHECK(unpinPage (bm, h));
+  }
+  h->pageNum = 3;
+  ASSERT_ERROR(markDirty (bm, h), "markDirty on an evicted page should fail");
+  TEST_CHECK(pinPage (bm, h, 3));
+  ASSERT_EQUALS_STRING("Page-3!", h->data, "dirty page was written on eviction");
+  TEST_CHECK(unpinPage (bm, h));
+
+  TEST_CHECK(shutdownBufferPool (bm));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+  free(other);
+
+  TEST_DONE();
+}
+
+static RC
+touchPages(BM_BufferPool *bm, PageNumber first, PageNumber last)
+{
+  BM_PageHandle h;
+  RC rc = RC_OK;
+
+  for (PageNumber pageNum = first; pageNum <= last && rc == RC_OK; pageNum++)
+  {
+    if ((rc = pinPage(bm, &h, pageNum)) == RC_OK)
+      rc = unpinPage(bm, &h);
+  }
+
+  return rc;
+}
+
+/* The pool holds its file open and grows it when a page past the end is pinned */
+void
+testPoolFile(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+
+  testName = "test pool page file";
+
+  destroyPageFile(TESTPF);
+  ASSERT_ERROR(initBufferPool (bm, TESTPF, 3, RS_CLOCK, NULL), "a pool on a missing file should fail");
+
+  createNumberedFile();
+  TEST_CHECK(initBufferPool (bm, TESTPF, 3, RS_CLOCK, NULL));
+  ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, pinPage (bm, h, -1), "a negative page number is not a page");
+  TEST_CHECK(pinPage (bm, h, NUM_FILE_PAGES));
+  ASSERT_TRUE((h->data[0] == 0), "a page past the end reads as zeros");
+  strcpy(h->data, "new page");
+  TEST_CHECK(markDirty (bm, h));
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(pinPage (bm, h, 0));
+  ASSERT_TRUE(pageHolds(h, 0), "existing pages are untouched");
+  TEST_CHECK(unpinPage (bm, h));
+
+  bool *dirty = getDirtyFlags(bm);
+  ASSERT_EQUALS_INT(1, dirty[0] + dirty[1] + dirty[2], "one flag per frame, only the new page is dirty");
+  free(dirty);
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(NUM_FILE_PAGES + 1, (int) fh.totalNumPages, "pinning grew the file by one page");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(initBufferPool (bm, TESTPF, 3, RS_CLOCK, NULL));
+  TEST_CHECK(pinPage (bm, h, NUM_FILE_PAGES));
+  ASSERT_EQUALS_STRING("new page", h->data, "the new page was written at shutdown");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  // the same file through a direct I/O pool, where the file system allows O_DIRECT
+  BM_PoolParams direct = {.directIO = TRUE};
+  TEST_CHECK(openPageFileDirect (TESTPF, &fh));
+  bool supported = isDirectIO(&fh) != 0;
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(initBufferPoolWithParams (bm, TESTPF, 3, RS_CLOCK, NULL, &direct));
+  ASSERT_EQUALS_INT(supported, isPoolDirectIO(bm), "the pool opened its file for direct I/O");
+  TEST_CHECK(pinPage (bm, h, 7));
+  ASSERT_TRUE(pageHolds(h, 7), "a direct read returns the page");
+  strcpy(h->data, "direct page");
+  TEST_CHECK(markDirty (bm, h));
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(touchPages (bm, 10, 20));
+  TEST_CHECK(pinPage (bm, h, 7));
+  ASSERT_EQUALS_STRING("direct page", h->data, "an evicted page was written and read back directly");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(shutdownBufferPool (bm));
+  TEST_CHECK(initBufferPool (bm, TESTPF, 3, RS_CLOCK, NULL));
+  ASSERT_TRUE(!isPoolDirectIO(bm), "initBufferPool keeps buffered I/O");
+  TEST_CHECK(shutdownBufferPool (bm));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  // debug output covers the whole of a large page
+  TEST_CHECK(createPageFileSized (TESTPF, 4 * PAGE_SIZE, 0));
+  TEST_CHECK(initBufferPool (bm, TESTPF, 3, RS_CLOCK, NULL));
+  TEST_CHECK(pinPage (bm, h, 0));
+  char *content = sprintPageContent(bm, h);
+  ASSERT_EQUALS_INT((int) strlen("[Page 0]\n") + 2 * 4 * PAGE_SIZE + 4 * PAGE_SIZE / 8 + 4 * PAGE_SIZE / 64, (int) strlen(content),
+                    "every byte of the pool's page size is printed");
+  free(content);
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+/* Pools on relations of one tablespace grow them and keep their pages apart */
+void
+testPoolRelation(void)
+{
+  BM_BufferPool *emp = MAKE_POOL();
+  BM_BufferPool *dept = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_Tablespace space;
+  SM_FileHandle fh;
+  BM_PoolParams onSpace = {.space = &space};
+  char expected[32];
+  int ok = 1;
+
+  testName = "test pool on a relation";
+
+  TEST_CHECK(createTablespace (TESTPF));
+  TEST_CHECK(openTablespace (TESTPF, &space));
+  TEST_CHECK(createRelation (&space, "emp"));
+  TEST_CHECK(createRelation (&space, "dept"));
+  ASSERT_ERROR(initBufferPoolWithParams (emp, "nothing", 3, RS_CLOCK, NULL, &onSpace), "a pool on a missing relation should fail");
+  TEST_CHECK(initBufferPoolWithParams (emp, "emp", 3, RS_CLOCK, NULL, &onSpace));
+  TEST_CHECK(initBufferPoolWithParams (dept, "dept", 3, RS_CLOCK, NULL, &onSpace));
+
+  // pinning past the end grows each relation, evictions write through the tablespace
+  for (int i = 0; i < 30; i++)
+  {
+    TEST_CHECK(pinPage (emp, h, i));
+    sprintf(h->data, "emp-%i", i);
+    TEST_CHECK(markDirty (emp, h));
+    TEST_CHECK(unpinPage (emp, h));
+    TEST_CHECK(pinPage (dept, h, i));
+    sprintf(h->data, "dept-%i", i);
+    TEST_CHECK(markDirty (dept, h));
+    TEST_CHECK(unpinPage (dept, h));
+  }
+  ASSERT_ERROR(closeTablespace (&space), "pools keep their relations open");
+  TEST_CHECK(shutdownBufferPool (emp));
+  TEST_CHECK(shutdownBufferPool (dept));
+  TEST_CHECK(closeTablespace (&space));
+
+  TEST_CHECK(openTablespace (TESTPF, &space));
+  TEST_CHECK(openRelation (&space, "emp", &fh));
+  ASSERT_EQUALS_INT(30, (int) fh.totalNumPages, "the relation grew with the pool");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(initBufferPoolWithParams (dept, "dept", 3, RS_CLOCK, NULL, &onSpace));
+  for (int i = 0; i < 30 && ok; i++)
+  {
+    sprintf(expected, "dept-%i", i);
+    ok = pinPage(dept, h, i) == RC_OK && strcmp(h->data, expected) == 0 && unpinPage(dept, h) == RC_OK;
+  }
+  ASSERT_TRUE(ok, "each relation reads back its own pages");
+  TEST_CHECK(shutdownBufferPool (dept));
+  TEST_CHECK(closeTablespace (&space));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(emp);
+  free(dept);
+  free(h);
+
+  TEST_DONE();
+}
+
+/* LRU-2 keeps twice-referenced pages through a scan, unless the second pin was correlated */
+void
+testLRUK(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_LRUKParams correlated = {2, 3, 0};
+  BM_LRUKParams retained = {2, 0, 10};
+  BM_LRUKParams invalid = {0, 0, 0};
+
+  testName = "test LRU-K replacement";
+
+  createNumberedFile();
+  ASSERT_ERROR(initBufferPool (bm, TESTPF, 4, RS_LRU_K, &invalid), "K of 0 should fail");
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, 4, RS_LRU_K, NULL));
+  TEST_CHECK(touchPages (bm, 0, 1));
+  TEST_CHECK(touchPages (bm, 0, 1));
+  TEST_CHECK(touchPages (bm, 10, 29));
+  ASSERT_EQUALS_INT(22, getNumReadIO(bm), "hot pages and the scan are read once");
+  TEST_CHECK(touchPages (bm, 0, 1));
+  ASSERT_EQUALS_INT(22, getNumReadIO(bm), "hot pages survive the scan");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  // pinning a page twice within the correlated period is a single reference
+  TEST_CHECK(initBufferPool (bm, TESTPF, 4, RS_LRU_K, &correlated));
+  TEST_CHECK(touchPages (bm, 0, 0));
+  TEST_CHECK(touchPages (bm, 0, 0));
+  TEST_CHECK(touchPages (bm, 10, 29));
+  TEST_CHECK(touchPages (bm, 0, 0));
+  ASSERT_EQUALS_INT(22, getNumReadIO(bm), "a correlated page is evicted by the scan");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  // page 5 comes back with its old reference and then outlives two newer single-reference pages
+  TEST_CHECK(initBufferPool (bm, TESTPF, 2, RS_LRU_K, &retained));
+  TEST_CHECK(touchPages (bm, 5, 7));
+  TEST_CHECK(touchPages (bm, 5, 5));
+  TEST_CHECK(touchPages (bm, 9, 10));
+  TEST_CHECK(touchPages (bm, 5, 5));
+  ASSERT_EQUALS_INT(6, getNumReadIO(bm), "retained history keeps a re-read page");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_LRU_K, NULL));
+  ASSERT_TRUE(randomPins(bm, 11, 5000), "every LRU-K pin returns the requested page");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+
+  TEST_DONE();
+}
+
+/* LFU keeps frequently pinned pages through a scan; with aging they leave once they go cold */
+void
+testLFU(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_LFUParams aging = {4};
+  int i;
+
+  testName = "test LFU replacement";
+
+  createNumberedFile();
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, 3, RS_LFU, NULL));
+  for (i = 0; i < 8; i++)
+    TEST_CHECK(touchPages (bm, 0, 1));
+  TEST_CHECK(touchPages (bm, 10, 29));
+  ASSERT_EQUALS_INT(22, getNumReadIO(bm), "hot pages and the scan are read once");
+  TEST_CHECK(touchPages (bm, 0, 1));
+  ASSERT_EQUALS_INT(22, getNumReadIO(bm), "frequent pages survive the scan");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, 3, RS_LFU, &aging));
+  for (i = 0; i < 8; i++)
+    TEST_CHECK(touchPages (bm, 0, 1));
+  TEST_CHECK(touchPages (bm, 10, 29));
+  TEST_CHECK(touchPages (bm, 0, 1));
+  ASSERT_TRUE((getNumReadIO(bm) > 22), "aged counts let stale pages go");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  // a pinned page at the front of the lowest bucket is skipped, not evicted
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_LFU, &aging));
+  TEST_CHECK(pinPage (bm, h, 0));
+  ASSERT_TRUE(randomPins(bm, 13, 5000), "every LFU pin returns the requested page");
+  ASSERT_TRUE(pageHolds(h, 0), "the pinned page stays in its frame");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+/* ARC keeps re-referenced pages through a scan and still adapts to a new loop */
+void
+testARC(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  int i, reads;
+
+  testName = "test ARC replacement";
+
+  createNumberedFile();
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, 4, RS_ARC, NULL));
+  TEST_CHECK(touchPages (bm, 0, 1));
+  TEST_CHECK(touchPages (bm, 0, 1));
+  TEST_CHECK(touchPages (bm, 10, 29));
+  ASSERT_EQUALS_INT(22, getNumReadIO(bm), "hot pages and the scan are read once");
+  TEST_CHECK(touchPages (bm, 0, 1));
+  ASSERT_EQUALS_INT(22, getNumReadIO(bm), "re-referenced pages survive the scan");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  // B1 hits grow T1 until a loop over pages seen once displaces the old frequent pages
+  TEST_CHECK(initBufferPool (bm, TESTPF, 4, RS_ARC, NULL));
+  TEST_CHECK(touchPages (bm, 0, 2));
+  TEST_CHECK(touchPages (bm, 0, 2));
+  for (i = 0; i < 4; i++)
+    TEST_CHECK(touchPages (bm, 10, 13));
+  reads = getNumReadIO(bm);
+  TEST_CHECK(touchPages (bm, 10, 13));
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "the new loop fits the pool");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_ARC, NULL));
+  ASSERT_TRUE(randomPins(bm, 17, 5000), "every ARC pin returns the requested page");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+
+  TEST_DONE();
+}
+
+typedef struct PinWorker
+{
+  BM_BufferPool *bm;
+  unsigned seed;
+  int ok;
+  pthread_t thread;
+} PinWorker;
+
+static void *
+pinWorker(void *arg)
+{
+  PinWorker *w = arg;
+
+  w->ok = randomPins(w->bm, w->seed, 2000);
+  return NULL;
+}
+
+// every thread adds one to a counter behind the page text of each page it pins
+static void *
+countWorker(void *arg)
+{
+  PinWorker *w = arg;
+  BM_PageHandle h;
+  int *counter;
+
+  w->ok = 1;
+  for (int i = 0; i < 1000 && w->ok; i++)
+  {
+    w->ok = pinPage(w->bm, &h, rand_r(&w->seed) % (2 * NUM_THREADS)) == RC_OK && latchPage(w->bm, &h, TRUE) == RC_OK;
+    if (!w->ok)
+      break;
+    counter = (int *) (h.data + 64);
+    (*counter)++;
+    w->ok = markDirty(w->bm, &h) == RC_OK && unlatchPage(w->bm, &h) == RC_OK && unpinPage(w->bm, &h) == RC_OK;
+  }
+
+  return NULL;
+}
+
+static int
+runWorkers(BM_BufferPool *bm, void *(*worker)(void *))
+{
+  PinWorker w[NUM_THREADS];
+  int ok = 1;
+
+  for (int i = 0; i < NUM_THREADS; i++)
+  {
+    w[i].bm = bm;
+    w[i].seed = 31 * i + 1;
+    pthread_create(&w[i].thread, NULL, worker, &w[i]);
+  }
+  for (int i = 0; i < NUM_THREADS; i++)
+  {
+    pthread_join(w[i].thread, NULL);
+    ok = ok && w[i].ok;
+  }
+
+  return ok;
+}
+
+static void
+dirtyPages(BM_BufferPool *bm, PageNumber first, PageNumber last)
+{
+  BM_PageHandle h;
+
+  for (PageNumber pageNum = first; pageNum <= last; pageNum++)
+  {
+    TEST_CHECK(pinPage (bm, &h, pageNum));
+    strcat(h.data, "*");
+    TEST_CHECK(markDirty (bm, &h));
+    TEST_CHECK(unpinPage (bm, &h));
+  }
+}
+
+static void *
+flushWorker(void *arg)
+{
+  PinWorker *w = arg;
+
+  w->ok = forceFlushPool(w->bm) == RC_OK;
+  return NULL;
+}
+
+/* A read that fails leaves its frame empty, and every strategy hands that frame out next */
+void
+testFailedLoad(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  ReplacementStrategy strategies[] = {RS_FIFO, RS_LRU, RS_CLOCK, RS_LRU_K, RS_LFU, RS_ARC};
+  int reads;
+
+  testName = "test failed page loads";
+
+  for (int i = 0; i < (int) (sizeof(strategies) / sizeof(strategies[0])); i++)
+  {
+    createNumberedFile();
+    TEST_CHECK(initBufferPool (bm, TESTPF, 4, strategies[i], NULL));
+    TEST_CHECK(touchPages (bm, 0, 3));
+
+    // the pool still believes in the pages cut off behind its back
+    if (truncate(TESTPF, 100 * PAGE_SIZE) != 0)
+      ASSERT_TRUE(false, "truncating the page file");
+    ASSERT_ERROR(pinPage (bm, h, 400), "pinning a page that cannot be read should fail");
+
+    // the failed pin evicted page 0, page 4 goes into its frame and 1 to 3 stay
+    TEST_CHECK(touchPages (bm, 4, 4));
+    reads = getNumReadIO(bm);
+    TEST_CHECK(touchPages (bm, 1, 3));
+    ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "the emptied frame was the next victim");
+    TEST_CHECK(shutdownBufferPool (bm));
+  }
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+/* Threads sharing a pool get the pages they pin, and exclusive latches keep updates */
+void
+testConcurrentPins(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int total = 0;
+
+  testName = "test concurrent pins";
+
+  createNumberedFile();
+  for (ReplacementStrategy strat = RS_FIFO; strat <= RS_ARC; strat++)
+  {
+    TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, strat, NULL));
+    ASSERT_TRUE(runWorkers(bm, pinWorker), "every concurrent pin returns the requested page");
+    int *fixCounts = getFixCounts(bm);
+    for (int i = 0; i < NUM_FRAMES; i++)
+      ASSERT_EQUALS_INT(0, fixCounts[i], "no pins are left behind");
+    free(fixCounts);
+    TEST_CHECK(shutdownBufferPool (bm));
+  }
+
+  // a frame per thread and one spare for twice as many hot pages, so updated pages are
+  // written and read back all the time
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_THREADS + 1, RS_LRU, NULL));
+  ASSERT_TRUE(runWorkers(bm, countWorker), "every latched update succeeds");
+  h->pageNum = 0;
+  ASSERT_ERROR(latchPage (bm, h, FALSE), "latching an unpinned page should fail");
+  for (PageNumber pageNum = 0; pageNum < 2 * NUM_THREADS; pageNum++)
+  {
+    TEST_CHECK(pinPage (bm, h, pageNum));
+    total += *(int *) (h->data + 64);
+    TEST_CHECK(unpinPage (bm, h));
+  }
+  ASSERT_EQUALS_INT(NUM_THREADS * 1000, total, "no update is lost");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  // a flush meets page 1 latched by a thread that goes on to latch page 0, which
+  // the flush must not hold while it waits
+  BM_PageHandle *other = MAKE_PAGE_HANDLE();
+  PinWorker flusher = {.bm = bm};
+  TEST_CHECK(initBufferPool (bm, TESTPF, 4, RS_FIFO, NULL));
+  dirtyPages(bm, 0, 1);
+  TEST_CHECK(pinPage (bm, h, 0));
+  TEST_CHECK(pinPage (bm, other, 1));
+  TEST_CHECK(latchPage (bm, other, TRUE));
+  pthread_create(&flusher.thread, NULL, flushWorker, &flusher);
+  usleep(50000);
+  TEST_CHECK(latchPage (bm, h, TRUE));
+  TEST_CHECK(unlatchPage (bm, h));
+  TEST_CHECK(unlatchPage (bm, other));
+  pthread_join(flusher.thread, NULL);
+  ASSERT_TRUE(flusher.ok, "the flush writes the latched page once it is released");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(unpinPage (bm, other));
+  ASSERT_EQUALS_INT(2, getNumWriteIO(bm), "both dirty pages were written");
+  TEST_CHECK(shutdownBufferPool (bm));
+  free(other);
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// background threads do the work, so the test polls a statistic for up to two seconds
+static int
+waitForCount(BM_BufferPool *bm, int (*count)(BM_BufferPool *const), int expected)
+{
+  for (int i = 0; i < 2000 && count(bm) < expected; i++)
+    usleep(1000);
+
+  return count(bm) >= expected;
+}
+
+/* The background writer cleans the pages next in line for eviction, so misses do not write */
+void
+testPoolWriter(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_WriterParams all = {100, 0, 1};
+  BM_WriterParams limited = {100, 4, 1000};
+  BM_WriterParams invalid = {101, 0, 1};
+
+  testName = "test background writer";
+
+  createNumberedFile();
+
+  // without a writer every dirty victim is written by the miss that evicts it
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_CLOCK, NULL));
+  dirtyPages(bm, 0, NUM_FRAMES - 1);
+  TEST_CHECK(touchPages (bm, NUM_FRAMES, 2 * NUM_FRAMES - 1));
+  ASSERT_EQUALS_INT(NUM_FRAMES, getNumEvictionWrites(bm), "misses wrote their dirty victims");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  for (ReplacementStrategy strat = RS_FIFO; strat <= RS_ARC; strat++)
+  {
+    TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, strat, NULL));
+    ASSERT_ERROR(startPoolWriter (bm, &invalid), "a clean share above 100% should fail");
+    TEST_CHECK(startPoolWriter (bm, &all));
+    ASSERT_EQUALS_INT(RC_WRITER_RUNNING, startPoolWriter (bm, &all), "one writer per pool");
+    dirtyPages(bm, 2 * NUM_FRAMES, 3 * NUM_FRAMES - 1);
+    ASSERT_TRUE(waitForCount(bm, getNumWriteIO, NUM_FRAMES), "the writer cleaned the pool");
+    TEST_CHECK(touchPages (bm, 3 * NUM_FRAMES, 4 * NUM_FRAMES - 1));
+    ASSERT_EQUALS_INT(0, getNumEvictionWrites(bm), "misses found clean victims");
+    TEST_CHECK(shutdownBufferPool (bm));
+  }
+
+  // one round of at most four pages, then a pause longer than the test waits
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+  dirtyPages(bm, 0, 9);
+  TEST_CHECK(startPoolWriter (bm, &limited));
+  ASSERT_TRUE(waitForCount(bm, getNumWriteIO, 4), "the writer ran a round");
+  usleep(50000);
+  ASSERT_EQUALS_INT(4, getNumWriteIO(bm), "the round was limited to four pages");
+  TEST_CHECK(stopPoolWriter (bm));
+  TEST_CHECK(stopPoolWriter (bm));
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  // pages written by the writer and at shutdown both reached the file
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_FIFO, NULL));
+  TEST_CHECK(pinPage (bm, h, 3));
+  ASSERT_EQUALS_STRING("Page-3**", h->data, "page dirtied twice");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(pinPage (bm, h, 2 * NUM_FRAMES));
+  ASSERT_EQUALS_STRING("Page-128******", h->data, "page cleaned by the writer under every strategy");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+/* Prefetched pages are read in the background, unpinned, and pinning them is a hit */
+void
+testPrefetch(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  PageNumber next[10], unused[10];
+  PageNumber skipped[] = {-1, NUM_FILE_PAGES, NUM_FILE_PAGES + 10};
+  SM_FileHandle fh;
+
+  testName = "test prefetching";
+
+  createNumberedFile();
+  for (int i = 0; i < 10; i++)
+  {
+    next[i] = 10 + i;
+    unused[i] = 200 + i;
+  }
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+  TEST_CHECK(prefetchPages (bm, next, 10));
+  ASSERT_TRUE(waitForCount(bm, getNumPrefetchReads, 10), "the pages were prefetched");
+  int *fixCounts = getFixCounts(bm);
+  for (int i = 0; i < NUM_FRAMES; i++)
+    ASSERT_EQUALS_INT(0, fixCounts[i], "prefetched pages are not pinned");
+  free(fixCounts);
+
+  for (int i = 0; i < 10; i++)
+  {
+    TEST_CHECK(pinPage (bm, h, next[i]));
+    ASSERT_TRUE(pageHolds(h, next[i]), "a prefetched page holds its data");
+    TEST_CHECK(unpinPage (bm, h));
+  }
+  ASSERT_EQUALS_INT(10, getNumReadIO(bm), "pins of prefetched pages are hits");
+
+  // resident pages and pages outside the file are not read again or created
+  TEST_CHECK(prefetchPages (bm, next, 10));
+  TEST_CHECK(prefetchPages (bm, skipped, 3));
+  TEST_CHECK(prefetchPages (bm, unused, 10));
+  ASSERT_TRUE(waitForCount(bm, getNumPrefetchReads, 20), "the unused pages were prefetched");
+  ASSERT_EQUALS_INT(20, getNumPrefetchReads(bm), "only missing pages are read");
+  ASSERT_EQUALS_INT(0, getNumPrefetchUnused(bm), "nothing was evicted yet");
+  TEST_CHECK(touchPages (bm, 300, 300 + NUM_FRAMES - 1));
+  ASSERT_EQUALS_INT(10, getNumPrefetchUnused(bm), "evicted prefetched pages that were never pinned");
+  ASSERT_ERROR(prefetchPages (bm, NULL, 1), "prefetching without page numbers should fail");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(NUM_FILE_PAGES, (int) fh.totalNumPages, "prefetching did not grow the file");
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_ARC, NULL));
+  TEST_CHECK(prefetchPages (bm, next, 10));
+  ASSERT_TRUE(randomPins(bm, 23, 5000), "pins racing the prefetcher return the requested page");
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+static RC
+scanPages(BM_BufferPool *bm, PageNumber first, PageNumber last)
+{
+  BM_PageHandle h;
+  RC rc = RC_OK;
+
+  for (PageNumber pageNum = first; pageNum <= last && rc == RC_OK; pageNum++)
+  {
+    if ((rc = pinPageHinted(bm, &h, pageNum, BM_ACCESS_SEQUENTIAL)) == RC_OK)
+      rc = unpinPage(bm, &h);
+  }
+
+  return rc;
+}
+
+/* Sequential pins recycle a small ring of frames and leave the working set resident */
+void
+testScanRing(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int reads;
+
+  testName = "test sequential scan ring";
+
+  createNumberedFile();
+  for (ReplacementStrategy strat = RS_FIFO; strat <= RS_ARC; strat++)
+  {
+    TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, strat, NULL));
+    TEST_CHECK(touchPages (bm, 0, NUM_FRAMES / 2 - 1));
+    TEST_CHECK(touchPages (bm, 0, NUM_FRAMES / 2 - 1));
+    reads = getNumReadIO(bm);
+    TEST_CHECK(scanPages (bm, 100, NUM_FILE_PAGES - 1));
+    ASSERT_EQUALS_INT(reads + NUM_FILE_PAGES - 100, getNumReadIO(bm), "every scanned page is read once");
+    TEST_CHECK(touchPages (bm, 0, NUM_FRAMES / 2 - 1));
+    ASSERT_EQUALS_INT(reads + NUM_FILE_PAGES - 100, getNumReadIO(bm), "the working set survived the scan");
+    TEST_CHECK(shutdownBufferPool (bm));
+  }
+
+  // a random pin takes a scanned page out of the ring, so the rest of the scan keeps it
+  TEST_CHECK(initBufferPool (bm, TESTPF, NUM_FRAMES, RS_LRU, NULL));
+  TEST_CHECK(scanPages (bm, 100, 100));
+  TEST_CHECK(pinPage (bm, h, 100));
+  ASSERT_TRUE(pageHolds(h, 100), "a scanned page is a hit for a random pin");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(scanPages (bm, 101, NUM_FILE_PAGES - 1));
+  reads = getNumReadIO(bm);
+  TEST_CHECK(pinPage (bm, h, 100));
+  ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "the page left the ring");
+  TEST_CHECK(unpinPage (bm, h));
+
+  // a scan page pinned by the scan is never recycled under it
+  TEST_CHECK(pinPageHinted (bm, h, 0, BM_ACCESS_SEQUENTIAL));
+  TEST_CHECK(scanPages (bm, 1, 99));
+  ASSERT_TRUE(pageHolds(h, 0), "a pinned ring page keeps its data");
+  TEST_CHECK(unpinPage (bm, h));
+  TEST_CHECK(shutdownBufferPool (bm));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
@@ -0,0 +1,989 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "storage_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTPF "test_pagefile.bin"
+
+/* prototypes for test functions */
+static void testCreateOpenClose(void);
+static void testSinglePageContent(void);
+static void testMultiPageContent(void);
+static void testMappedPages(void);
+static void testDirectIO(void);
+static void testAsyncIO(int flags);
+static void testExtentGrowth(void);
+static void testFreePageReuse(void);
+static void testSegmentedFile(void);
+static void testPageSizes(void);
+static void testReadahead(void);
+static void testConcurrentReadahead(void);
+static void testDurability(void);
+static void testFileStats(void);
+static void testCompressedFile(void);
+static void testTablespace(void);
+
+/* main function running all tests */
+int
+main (void)
+{
+  testName = "";
+
+  initStorageManager();
+
+  testCreateOpenClose();
+  testSinglePageContent();
+  testMultiPageContent();
+  testMappedPages();
+  testDirectIO();
+  testAsyncIO(0);
+  testAsyncIO(SM_ASYNC_POLL);
+  testAsyncIO(SM_ASYNC_THREADS | SM_ASYNC_POLL);
+  testExtentGrowth();
+  testFreePageReuse();
+  testSegmentedFile();
+  testPageSizes();
+  testReadahead();
+  testConcurrentReadahead();
+  testDurability();
+  testFileStats();
+  testCompressedFile();
+  testTablespace();
+
+  return 0;
+}
+
+
+/* Try to create, open, and close a page file */
+void
+testCreateOpenClose(void)
+{
+  SM_FileHandle fh;
+
+  testName = "test create open and close methods";
+
+  TEST_CHECK(createPageFile (TESTPF));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(strcmp(fh.fileName, TESTPF) == 0, "filename correct");
+  ASSERT_TRUE((fh.totalNumPages == 1), "expect 1 page in new file");
+  ASSERT_TRUE((fh.curPagePos == 0), "freshly opened file's page position should be 0");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  // after destruction trying to open the file should cause an error
+  ASSERT_TRUE((openPageFile(TESTPF, &fh) != RC_OK), "opening non-existing file should return an error.");
+
+  TEST_DONE();
+}
+
+/* Write a page, read it back and check the cursor moves with it */
+void
+testSinglePageContent(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  int i;
+
+  testName = "test single page content";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+
+  // the first page should be empty (zero bytes)
+  TEST_CHECK(readFirstBlock (&fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    ASSERT_TRUE((ph[i] == 0), "expected zero byte in first page of freshly initialized page");
+
+  for (i=0; i < PAGE_SIZE; i++)
+    ph[i] = (i % 10) + '0';
+  TEST_CHECK(writeBlock (0, &fh, ph));
+
+  memset(ph, 0, PAGE_SIZE);
+  TEST_CHECK(readFirstBlock (&fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    ASSERT_TRUE((ph[i] == (i % 10) + '0'), "character in page read from disk is the one we expected.");
+
+  // writing one page past the end appends it
+  TEST_CHECK(writeBlock (1, &fh, ph));
+  ASSERT_EQUALS_INT(2, (int) fh.totalNumPages, "write past the end appends a page");
+  TEST_CHECK(readLastBlock (&fh, ph));
+  ASSERT_EQUALS_INT(1, (int) getBlockPos(&fh), "cursor is on the last page");
+  ASSERT_ERROR(readNextBlock (&fh, ph), "reading past the last page should fail");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Move several pages with one readBlocks/writeBlocks call */
+void
+testMultiPageContent(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[8];
+  int i, j;
+
+  testName = "test multi page content";
+
+  for (i=0; i < 8; i++)
+    pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (3, &fh));
+  ASSERT_EQUALS_INT(3, (int) fh.totalNumPages, "ensureCapacity grows the file");
+
+  for (i=0; i < 8; i++)
+    memset(pages[i], 'a' + i, PAGE_SIZE);
+  TEST_CHECK(writeBlocks (1, 8, &fh, pages));
+  ASSERT_EQUALS_INT(9, (int) fh.totalNumPages, "vectored write extends the file");
+  ASSERT_ERROR(writeBlocks (11, 1, &fh, pages), "write with a gap after the end should fail");
+
+  for (i=0; i < 8; i++)
+    memset(pages[i], 0, PAGE_SIZE);
+  TEST_CHECK(readBlocks (1, 8, &fh, pages));
+  for (i=0; i < 8; i++)
+    for (j=0; j < PAGE_SIZE; j++)
+      if (pages[i][j] != 'a' + i)
+        ASSERT_TRUE(0, "page read back by readBlocks has the written content");
+  ASSERT_EQUALS_INT(8, (int) getBlockPos(&fh), "cursor is on the last page of the run");
+  ASSERT_ERROR(readBlocks (5, 5, &fh, pages), "run reaching past the end should fail");
+
+  TEST_CHECK(readPreviousBlock (&fh, pages[0]));
+  ASSERT_TRUE((pages[0][0] == 'a' + 6), "previous block is page 7");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  for (i=0; i < 8; i++)
+    free(pages[i]);
+
+  TEST_DONE();
+}
+
+/* Pages of a mapped file are read and written in place */
+void
+testMappedPages(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph, mapped;
+
+  testName = "test mapped page file";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFileMapped (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (4, &fh));
+  ASSERT_EQUALS_INT(4, (int) fh.totalNumPages, "mapped file grows");
+
+  TEST_CHECK(mapBlock (3, &fh, &mapped));
+  ASSERT_TRUE((mapped[0] == 0 && mapped[PAGE_SIZE - 1] == 0), "grown page reads back as zeros");
+  memset(mapped, 'm', PAGE_SIZE);
+  TEST_CHECK(syncBlocks (3, 1, &fh));
+
+  memset(ph, 'w', PAGE_SIZE);
+  TEST_CHECK(writeBlock (4, &fh, ph));
+  ASSERT_EQUALS_INT(5, (int) fh.totalNumPages, "write past the end of a mapped file appends");
+  TEST_CHECK(closePageFile (&fh));
+
+  // the changes made through the mapping are visible to the regular read path
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(readBlock (3, &fh, ph));
+  ASSERT_TRUE((ph[0] == 'm' && ph[PAGE_SIZE - 1] == 'm'), "page written through the mapping");
+  TEST_CHECK(readBlock (4, &fh, ph));
+  ASSERT_TRUE((ph[0] == 'w'), "page written with writeBlock");
+  ASSERT_ERROR(mapBlock (0, &fh, &mapped), "mapBlock needs a mapped handle");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Direct I/O handles take aligned and unaligned page buffers alike */
+void
+testDirectIO(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle aligned, unaligned, raw;
+
+  testName = "test direct io page file";
+
+  TEST_CHECK((posix_memalign((void **) &aligned, SM_IO_ALIGNMENT, PAGE_SIZE) == 0) ? RC_OK : RC_MEMORY_ALLOCATION_FAILED);
+  raw = (SM_PageHandle) malloc(PAGE_SIZE + 1);
+  unaligned = raw + 1;
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFileDirect (TESTPF, &fh));
+  printf("direct io %s\n", isDirectIO(&fh) ? "enabled" : "not supported, using buffered io");
+
+  memset(aligned, 'a', PAGE_SIZE);
+  memset(unaligned, 'u', PAGE_SIZE);
+  TEST_CHECK(writeBlock (0, &fh, aligned));
+  TEST_CHECK(writeBlock (1, &fh, unaligned));
+  TEST_CHECK(appendEmptyBlock (&fh));
+  ASSERT_EQUALS_INT(3, (int) fh.totalNumPages, "direct io file grows");
+
+  TEST_CHECK(readBlock (1, &fh, aligned));
+  ASSERT_TRUE((aligned[0] == 'u' && aligned[PAGE_SIZE - 1] == 'u'), "unaligned write read back into aligned page");
+  TEST_CHECK(readBlock (2, &fh, unaligned));
+  ASSERT_TRUE((unaligned[0] == 0 && unaligned[PAGE_SIZE - 1] == 0), "appended page is empty");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(aligned);
+  free(raw);
+
+  TEST_DONE();
+}
+
+/* Queue writes and reads asynchronously and reap their completions */
+void
+testAsyncIO(int flags)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[4];
+  SM_Completion done[4];
+  int i, reaped, seen;
+
+  testName = "test asynchronous io";
+
+  for (i=0; i < 4; i++)
+    pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_ERROR(submitRead (0, &fh, pages[0], NULL), "submit before initAsyncIO should fail");
+  TEST_CHECK(initAsyncIO (&fh, 4, flags));
+  printf("async backend: %s\n", isAsyncRing(&fh) ? "io_uring" : "worker threads");
+  TEST_CHECK(ensureCapacity (4, &fh));
+
+  for (i=0; i < 4; i++)
+  {
+    memset(pages[i], 'A' + i, PAGE_SIZE);
+    TEST_CHECK(submitWrite (i, &fh, pages[i], pages[i]));
+  }
+  ASSERT_ERROR(submitWrite (0, &fh, pages[0], NULL), "submitting to a full queue should fail");
+
+  for (reaped = 0, seen = 0; reaped < 4; )
+  {
+    int n = reapCompletions(&fh, done, 4, 1);
+    for (i=0; i < n; i++)
+    {
+      TEST_CHECK(done[i].result);
+      seen |= 1 << done[i].pageNum;
+    }
+    reaped += n;
+  }
+  ASSERT_EQUALS_INT(15, seen, "every write completed once");
+
+  for (i=0; i < 4; i++)
+  {
+    memset(pages[i], 0, PAGE_SIZE);
+    TEST_CHECK(submitRead (3 - i, &fh, pages[i], (void *) (long) (3 - i)));
+  }
+  ASSERT_EQUALS_INT(4, reapCompletions(&fh, done, 4, 4), "waiting for all reads");
+  for (i=0; i < 4; i++)
+  {
+    TEST_CHECK(done[i].result);
+    ASSERT_EQUALS_INT((int) done[i].pageNum, (int) (long) done[i].cookie, "cookie travels with the request");
+  }
+  for (i=0; i < 4; i++)
+    ASSERT_TRUE((pages[i][0] == 'A' + 3 - i && pages[i][PAGE_SIZE - 1] == 'A' + 3 - i), "page read asynchronously");
+  ASSERT_EQUALS_INT(0, reapCompletions(&fh, done, 4, 0), "nothing left to reap");
+
+  // closing the file tears the queue down
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  for (i=0; i < 4; i++)
+    free(pages[i]);
+
+  TEST_DONE();
+}
+
+/* Files grow in preallocated extents while totalNumPages stays logical */
+void
+testExtentGrowth(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  int i, allocated;
+
+  testName = "test extent growth";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(1, (int) getAllocatedBlocks(&fh), "new file allocates one page");
+
+  TEST_CHECK(appendEmptyBlock (&fh));
+  allocated = getAllocatedBlocks(&fh);
+  ASSERT_EQUALS_INT(2, (int) fh.totalNumPages, "append adds one logical page");
+  ASSERT_TRUE((allocated > 2), "append allocates a whole extent");
+
+  // appends inside the extent do not allocate again
+  for (i = fh.totalNumPages; i < allocated; i++)
+    TEST_CHECK(appendEmptyBlock (&fh));
+  ASSERT_EQUALS_INT(allocated, (int) getAllocatedBlocks(&fh), "extent is used up before growing");
+
+  TEST_CHECK(ensureCapacity (1000, &fh));
+  ASSERT_EQUALS_INT(1000, (int) fh.totalNumPages, "ensureCapacity sets the logical size");
+  ASSERT_TRUE((getAllocatedBlocks(&fh) >= 1000), "allocation covers the logical size");
+
+  TEST_CHECK(readBlock (999, &fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    if (ph[i] != 0)
+      ASSERT_TRUE(0, "preallocated page reads back as zeros");
+  memset(ph, 'z', PAGE_SIZE);
+  TEST_CHECK(writeBlock (1000, &fh, ph));
+  TEST_CHECK(closePageFile (&fh));
+
+  // the logical size survives reopening
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(1001, (int) fh.totalNumPages, "logical size is persistent");
+  TEST_CHECK(readLastBlock (&fh, ph));
+  ASSERT_TRUE((ph[0] == 'z'), "last page content survives reopening");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  // files without a page file header are rejected
+  FILE *f = fopen(TESTPF, "w");
+  fputs("not a page file", f);
+  fclose(f);
+  ASSERT_ERROR(openPageFile (TESTPF, &fh), "opening a file without header should fail");
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Freed pages are remembered in the header and handed out again */
+void
+testFreePageReuse(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  PageNumber page;
+  int i;
+
+  testName = "test free page reuse";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(allocatePage (&fh, &page));
+  ASSERT_EQUALS_INT(1, (int) page, "allocating without free pages appends");
+
+  TEST_CHECK(ensureCapacity (40, &fh));
+  memset(ph, 'x', PAGE_SIZE);
+  for (i = 5; i < 30; i++)
+    TEST_CHECK(writeBlock (i, &fh, ph));
+
+  TEST_CHECK(setHolePunching (&fh, 16));
+  for (i = 29; i >= 10; i--)
+    TEST_CHECK(freePage (i, &fh));
+  TEST_CHECK(freePage (7, &fh));
+  TEST_CHECK(freePage (7, &fh));
+  ASSERT_EQUALS_INT(21, (int) getNumFreePages(&fh), "freeing a page twice counts once");
+  ASSERT_ERROR(freePage (40, &fh), "freeing a page past the end should fail");
+  TEST_CHECK(closePageFile (&fh));
+
+  // the free-page map is persistent and reused lowest page first
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(21, (int) getNumFreePages(&fh), "free pages survive reopening");
+  TEST_CHECK(allocatePage (&fh, &page));
+  ASSERT_EQUALS_INT(7, (int) page, "lowest free page is reused first");
+  TEST_CHECK(readBlock (7, &fh, ph));
+  ASSERT_TRUE((ph[0] == 0 && ph[PAGE_SIZE - 1] == 0), "reused page is empty");
+  TEST_CHECK(allocatePage (&fh, &page));
+  ASSERT_EQUALS_INT(10, (int) page, "next free page");
+  ASSERT_EQUALS_INT(40, (int) fh.totalNumPages, "reuse does not grow the file");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* A segmented file spreads its pages over TESTPF, TESTPF.1, TESTPF.2, ... */
+void
+testSegmentedFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[10];
+  SM_Completion done[1];
+  int i;
+
+  testName = "test segmented page file";
+
+  for (i = 0; i < 10; i++)
+    pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFileSegmented (TESTPF, 4));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(4, (int) getSegmentPages(&fh), "segment size is kept in the header");
+
+  // one vectored write crossing two segment boundaries
+  for (i = 0; i < 10; i++)
+    memset(pages[i], '0' + i, PAGE_SIZE);
+  TEST_CHECK(writeBlocks (0, 10, &fh, pages));
+  ASSERT_EQUALS_INT(10, (int) fh.totalNumPages, "write extends the segmented file");
+  ASSERT_TRUE((access(TESTPF ".2", F_OK) == 0), "third segment file exists");
+  TEST_CHECK(syncBlocks (2, 6, &fh));
+  TEST_CHECK(closePageFile (&fh));
+
+  ASSERT_ERROR(openPageFileMapped (TESTPF, &fh), "segmented files cannot be mapped");
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(10, (int) fh.totalNumPages, "logical size survives reopening");
+  for (i = 0; i < 10; i++)
+    memset(pages[i], 0, PAGE_SIZE);
+  TEST_CHECK(readBlocks (2, 6, &fh, pages));
+  for (i = 0; i < 6; i++)
+    ASSERT_TRUE((pages[i][0] == '2' + i && pages[i][PAGE_SIZE - 1] == '2' + i), "page read back from its segment");
+
+  // asynchronous requests address the right segment too
+  TEST_CHECK(initAsyncIO (&fh, 4, 0));
+  memset(pages[0], 'a', PAGE_SIZE);
+  TEST_CHECK(submitWrite (10, &fh, pages[0], NULL));
+  ASSERT_EQUALS_INT(1, reapCompletions (&fh, done, 1, 1), "one completion");
+  TEST_CHECK(done[0].result);
+  TEST_CHECK(submitRead (9, &fh, pages[1], NULL));
+  ASSERT_EQUALS_INT(1, reapCompletions (&fh, done, 1, 1), "one completion");
+  ASSERT_TRUE((pages[1][0] == '9'), "async read from the third segment");
+  TEST_CHECK(readBlock (10, &fh, pages[1]));
+  ASSERT_TRUE((pages[1][0] == 'a'), "async write to the third segment");
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  ASSERT_TRUE((access(TESTPF ".1", F_OK) != 0 && access(TESTPF ".2", F_OK) != 0), "destroy removes every segment");
+
+  for (i = 0; i < 10; i++)
+    free(pages[i]);
+
+  TEST_DONE();
+}
+
+/* The page size is picked per file and kept in its header */
+void
+testPageSizes(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[3];
+  SM_PageHandle mapped;
+  int i, size = 16384;
+
+  testName = "test page sizes";
+
+  for (i = 0; i < 3; i++)
+    pages[i] = (SM_PageHandle) malloc(SM_MAX_PAGE_SIZE);
+
+  ASSERT_ERROR(createPageFileSized (TESTPF, 2048, 0), "pages below SM_MIN_PAGE_SIZE are rejected");
+  ASSERT_ERROR(createPageFileSized (TESTPF, 12288, 0), "page sizes must be a power of two");
+  ASSERT_ERROR(createPageFileSized (TESTPF, 2 * SM_MAX_PAGE_SIZE, 0), "pages above SM_MAX_PAGE_SIZE are rejected");
+
+  TEST_CHECK(createPageFileSized (TESTPF, size, 0));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(size, getPageSize(&fh), "page size comes from the header");
+  for (i = 0; i < 3; i++)
+    memset(pages[i], 'a' + i, size);
+  TEST_CHECK(writeBlocks (1, 3, &fh, pages));
+  TEST_CHECK(closePageFile (&fh));
+
+  // whole pages of the larger size come back, also through a mapping
+  TEST_CHECK(openPageFileMapped (TESTPF, &fh));
+  ASSERT_EQUALS_INT(4, (int) fh.totalNumPages, "pages counted in the file's page size");
+  TEST_CHECK(mapBlock (3, &fh, &mapped));
+  ASSERT_TRUE((mapped[0] == 'c' && mapped[size - 1] == 'c'), "mapped page spans the whole page size");
+  TEST_CHECK(readBlock (2, &fh, pages[0]));
+  ASSERT_TRUE((pages[0][0] == 'b' && pages[0][size - 1] == 'b'), "read page spans the whole page size");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  // large pages in a segmented file
+  TEST_CHECK(createPageFileSized (TESTPF, SM_MAX_PAGE_SIZE, 2));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  memset(pages[0], 'z', SM_MAX_PAGE_SIZE);
+  TEST_CHECK(writeBlock (1, &fh, pages[0]));
+  TEST_CHECK(writeBlock (2, &fh, pages[0]));
+  memset(pages[1], 0, SM_MAX_PAGE_SIZE);
+  TEST_CHECK(readBlock (2, &fh, pages[1]));
+  ASSERT_TRUE((pages[1][SM_MAX_PAGE_SIZE - 1] == 'z'), "large page read back from the second segment");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  for (i = 0; i < 3; i++)
+    free(pages[i]);
+
+  TEST_DONE();
+}
+
+/* Sequential reads go through the readahead staging cache and still see every write */
+void
+testReadahead(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  int i, ok;
+
+  testName = "test sequential readahead";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  for (i = 0; i < 100; i++)
+  {
+    memset(ph, i, PAGE_SIZE);
+    TEST_CHECK(writeBlock (i, &fh, ph));
+  }
+
+  // a full scan with readNextBlock
+  TEST_CHECK(readFirstBlock (&fh, ph));
+  for (i = 1, ok = 1; i < 100; i++)
+  {
+    TEST_CHECK(readNextBlock (&fh, ph));
+    ok = ok && ph[0] == (char) i && ph[PAGE_SIZE - 1] == (char) i;
+  }
+  ASSERT_TRUE(ok, "every page of the scan has its own content");
+  ASSERT_TRUE((readNextBlock (&fh, ph) != RC_OK), "the scan ends at the last page");
+
+  // a write into the staged window is not hidden by it
+  TEST_CHECK(readBlock (10, &fh, ph));
+  TEST_CHECK(readBlock (11, &fh, ph));
+  TEST_CHECK(readBlock (12, &fh, ph));
+  memset(ph, 'w', PAGE_SIZE);
+  TEST_CHECK(writeBlock (14, &fh, ph));
+  TEST_CHECK(readBlock (13, &fh, ph));
+  ASSERT_TRUE((ph[0] == 13), "staged page before the write");
+  TEST_CHECK(readBlock (14, &fh, ph));
+  ASSERT_TRUE((ph[0] == 'w'), "write is visible to the sequential reader");
+
+  // random reads and readahead switched off
+  TEST_CHECK(readBlock (77, &fh, ph));
+  ASSERT_TRUE((ph[0] == 77), "random read after a run");
+  TEST_CHECK(setReadahead (&fh, 0));
+  ASSERT_ERROR(setReadahead (&fh, SM_READAHEAD_MAX + 1), "window above SM_READAHEAD_MAX is rejected");
+  for (i = 40, ok = 1; i < 50; i++)
+  {
+    TEST_CHECK(readBlock (i, &fh, ph));
+    ok = ok && ph[0] == (char) i;
+  }
+  ASSERT_TRUE(ok, "sequential reads without readahead");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Threads scanning one handle share its staging cache */
+#define NUM_READERS 4
+#define NUM_SCAN_PAGES 300
+
+typedef struct ScanWorker
+{
+  SM_FileHandle *fh;
+  int first;
+  int ok;
+  pthread_t thread;
+} ScanWorker;
+
+static void *
+scanWorker(void *arg)
+{
+  ScanWorker *w = arg;
+  SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  int round, i;
+
+  // each reader starts somewhere else and wraps around, twice
+  w->ok = (ph != NULL);
+  for (round = 0; round < 2 && w->ok; round++)
+    for (i = 0; i < NUM_SCAN_PAGES && w->ok; i++)
+    {
+      int page = (w->first + i) % NUM_SCAN_PAGES;
+
+      w->ok = readBlock(page, w->fh, ph) == RC_OK && ph[0] == (char) page && ph[PAGE_SIZE - 1] == (char) page;
+    }
+
+  free(ph);
+  return NULL;
+}
+
+void
+testConcurrentReadahead(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  ScanWorker w[NUM_READERS];
+  int i, ok;
+
+  testName = "test concurrent readers with readahead";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  for (i = 0; i < NUM_SCAN_PAGES; i++)
+  {
+    memset(ph, i, PAGE_SIZE);
+    TEST_CHECK(writeBlock (i, &fh, ph));
+  }
+  TEST_CHECK(setReadahead (&fh, SM_READAHEAD_MAX));
+
+  for (i = 0; i < NUM_READERS; i++)
+  {
+    w[i].fh = &fh;
+    w[i].first = i * (NUM_SCAN_PAGES / NUM_READERS);
+    pthread_create(&w[i].thread, NULL, scanWorker, &w[i]);
+  }
+  for (i = 0, ok = 1; i < NUM_READERS; i++)
+  {
+    pthread_join(w[i].thread, NULL);
+    ok = ok && w[i].ok;
+  }
+  ASSERT_TRUE(ok, "every reader sees each page whole and in place");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Each durability policy syncs at its own time and the cost is counted */
+void
+testDurability(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_FileStats stats;
+  int i;
+
+  testName = "test durability policies";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  memset(ph, 'd', PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(SM_SYNC_NONE, getDurability(&fh), "new files leave write-back to the kernel");
+  TEST_CHECK(writeBlock (0, &fh, ph));
+  TEST_CHECK(syncPageFile (&fh));
+  TEST_CHECK(getFileStats (&fh, &stats));
+  ASSERT_EQUALS_INT(0, (int) stats.numSyncs, "no sync without a policy");
+
+  // sync on flush, kept across reopening
+  TEST_CHECK(setDurability (&fh, SM_SYNC_ON_FLUSH, 0));
+  ASSERT_ERROR(setDurability (&fh, (SM_Durability) 9, 0), "unknown policy is rejected");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(SM_SYNC_ON_FLUSH, getDurability(&fh), "policy is stored in the header");
+  TEST_CHECK(writeBlock (1, &fh, ph));
+  TEST_CHECK(syncPageFile (&fh));
+  TEST_CHECK(getFileStats (&fh, &stats));
+  ASSERT_EQUALS_INT(1, (int) stats.numSyncs, "syncPageFile syncs once");
+
+  // write-behind kicks write-back every 4 pages
+  TEST_CHECK(setDurability (&fh, SM_SYNC_WRITE_BEHIND, 4));
+  for (i = 0; i < 10; i++)
+    TEST_CHECK(writeBlock (i, &fh, ph));
+  TEST_CHECK(getFileStats (&fh, &stats));
+  ASSERT_EQUALS_INT(2, (int) stats.numWriteBehind, "one write-behind round per 4 pages");
+  TEST_CHECK(syncPageFile (&fh));
+
+  // the periodic syncer covers writes without any call from the writer
+  TEST_CHECK(setDurability (&fh, SM_SYNC_PERIODIC, 10));
+  TEST_CHECK(getFileStats (&fh, &stats));
+  long long before = stats.numSyncs;
+  TEST_CHECK(writeBlock (2, &fh, ph));
+  for (i = 0; i < 200 && stats.numSyncs == before; i++)
+  {
+    usleep(5000);
+    TEST_CHECK(getFileStats (&fh, &stats));
+  }
+  ASSERT_TRUE((stats.numSyncs > before), "background thread synced the write");
+  ASSERT_TRUE((stats.syncNanos > 0), "sync time is counted");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Per-handle counters tell sequential from random I/O and time every call */
+void
+testFileStats(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_FileStats stats;
+  long long reads;
+  int i;
+
+  testName = "test file statistics";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  memset(ph, 's', PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(setReadahead (&fh, 0));
+  TEST_CHECK(resetFileStats (&fh));
+
+  for (i = 0; i < 8; i++)
+    TEST_CHECK(writeBlock (i, &fh, ph));
+  TEST_CHECK(readBlock (5, &fh, ph));
+  TEST_CHECK(readBlock (2, &fh, ph));
+  TEST_CHECK(readBlock (3, &fh, ph));
+
+  TEST_CHECK(getFileStats (&fh, &stats));
+  ASSERT_TRUE((stats.bytesWritten >= 8 * PAGE_SIZE), "every written page is counted");
+  ASSERT_EQUALS_INT(3 * PAGE_SIZE, (int) stats.bytesRead, "every read page is counted");
+  ASSERT_EQUALS_INT(3, (int) stats.numReadCalls, "one preadv per uncached page");
+  ASSERT_TRUE((stats.numWriteCalls >= 8), "at least one pwritev per page");
+  ASSERT_EQUALS_INT(9, (int) stats.numSequential, "writes from page 0 on and the read after page 2 are sequential");
+  ASSERT_EQUALS_INT(2, (int) stats.numRandom, "the two jumps are random");
+
+  for (i = 0, reads = 0; i < SM_LATENCY_BUCKETS; i++)
+    reads += stats.readLatency[i];
+  ASSERT_EQUALS_INT(3, (int) reads, "every readBlock lands in the histogram");
+  ASSERT_TRUE((getLatencyPercentile(stats.writeLatency, 50) > 0 &&
+      getLatencyPercentile(stats.writeLatency, 50) <= getLatencyPercentile(stats.writeLatency, 99)),
+      "percentiles come from the histogram");
+  printFileStats(&fh);
+
+  TEST_CHECK(resetFileStats (&fh));
+  TEST_CHECK(getFileStats (&fh, &stats));
+  ASSERT_EQUALS_INT(0, (int) (stats.bytesRead + stats.numRandom + stats.writeLatency[0]), "reset clears the counters");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* Padded record pages shrink on disk and come back byte for byte */
+void
+testCompressedFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph, noise;
+  SM_FileStats stats;
+  struct stat st;
+  int i, j, ok;
+
+  testName = "test compressed page file";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  noise = (SM_PageHandle) malloc(PAGE_SIZE);
+  srand(7);
+  for (i = 0; i < PAGE_SIZE; i++)
+    noise[i] = (char) rand();
+
+  TEST_CHECK(createPageFileCompressed (TESTPF, PAGE_SIZE));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(isCompressed(&fh), "compression is a property of the file");
+  ASSERT_ERROR(initAsyncIO (&fh, 4, 0), "compressed files have no async I/O");
+
+  // fixed-width records: a short name padded with blanks
+  for (i = 0; i < 64; i++)
+  {
+    memset(ph, ' ', PAGE_SIZE);
+    for (j = 0; j < PAGE_SIZE; j += 64)
+      sprintf(ph + j, "rec-%d-%d", i, j);
+    TEST_CHECK(writeBlock (i, &fh, ph));
+  }
+  TEST_CHECK(writeBlock (64, &fh, noise));
+  TEST_CHECK(closePageFile (&fh));
+
+  ASSERT_TRUE((stat(TESTPF, &st) == 0 && st.st_size < 65 * PAGE_SIZE / 3), "pages take less than a third of the space");
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(65, (int) fh.totalNumPages, "page count survives reopening");
+  TEST_CHECK(resetFileStats (&fh));
+  for (i = 0, ok = 1; i < 64; i++)
+  {
+    TEST_CHECK(readBlock (i, &fh, ph));
+    ok = ok && strncmp(ph + 128, "rec-", 4) == 0 && ph[PAGE_SIZE - 1] == ' ';
+  }
+  TEST_CHECK(readBlock (33, &fh, ph));
+  ASSERT_TRUE((strcmp(ph + 640, "rec-33-640") == 0 && ph[651] == ' '), "record comes back at its offset");
+  ASSERT_TRUE(ok, "every page decompresses");
+  TEST_CHECK(getFileStats (&fh, &stats));
+  ASSERT_TRUE((stats.bytesRead < 65 * PAGE_SIZE / 3), "reads move compressed bytes");
+
+  TEST_CHECK(readBlock (64, &fh, ph));
+  ASSERT_TRUE((memcmp(ph, noise, PAGE_SIZE) == 0), "incompressible page is stored as is");
+
+  // rewriting and freeing pages reuses slots instead of growing the file
+  for (j = 0; j < 50; j++)
+  {
+    memset(ph, 'a' + j % 26, PAGE_SIZE);
+    for (i = 0; i < 64; i++)
+      TEST_CHECK(writeBlock (i, &fh, ph));
+    TEST_CHECK(syncBlocks (0, 64, &fh));
+  }
+  TEST_CHECK(freePage (64, &fh));
+  TEST_CHECK(appendEmptyBlock (&fh));
+  TEST_CHECK(closePageFile (&fh));
+  ASSERT_TRUE((stat(TESTPF, &st) == 0 && st.st_size < 65 * PAGE_SIZE / 3), "rewrites reuse slots");
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(readBlock (10, &fh, ph));
+  ASSERT_TRUE((ph[0] == 'a' + 49 % 26 && ph[PAGE_SIZE - 1] == 'a' + 49 % 26), "last rewrite wins");
+  TEST_CHECK(readBlock (64, &fh, ph));
+  ASSERT_TRUE((ph[0] == 0 && ph[PAGE_SIZE - 1] == 0), "freed page reads back empty");
+  TEST_CHECK(readBlock (65, &fh, ph));
+  ASSERT_TRUE((ph[0] == 0), "appended page is empty");
+  TEST_CHECK(closePageFile (&fh));
+
+  ASSERT_ERROR(openPageFileMapped (TESTPF, &fh), "compressed files cannot be mapped");
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+  free(noise);
+
+  TEST_DONE();
+}
+
+/* Relations share one file, survive reopening and hand back their extents */
+void
+testTablespace(void)
+{
+  SM_Tablespace space;
+  SM_FileHandle emp, dept, view;
+  SM_FileStats stats;
+  SM_PageHandle ph;
+  PageNumber page, reused, got;
+  char name[SM_RELATION_NAME_MAX];
+  int i, ok;
+
+  testName = "test tablespace";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createTablespace (TESTPF));
+  TEST_CHECK(openTablespace (TESTPF, &space));
+  TEST_CHECK(createRelation (&space, "emp"));
+  TEST_CHECK(createRelation (&space, "dept"));
+  ASSERT_ERROR(createRelation (&space, "emp"), "relation names are unique");
+  ASSERT_ERROR(openRelation (&space, "nothing", &emp), "opening a missing relation should fail");
+
+  // two relations growing side by side get interleaved extents
+  TEST_CHECK(openRelation (&space, "emp", &emp));
+  TEST_CHECK(openRelation (&space, "dept", &dept));
+  ASSERT_EQUALS_INT(1, (int) emp.totalNumPages, "a new relation has one page");
+  for (i = 0; i < 40; i++)
+  {
+    memset(ph, 'e', PAGE_SIZE);
+    sprintf(ph, "emp %d", i);
+    TEST_CHECK(writeBlock (i, &emp, ph));
+    memset(ph, 'd', PAGE_SIZE);
+    sprintf(ph, "dept %d", i);
+    TEST_CHECK(writeBlock (i, &dept, ph));
+  }
+  ASSERT_TRUE((getAllocatedBlocks(&emp) >= 40), "extents cover the relation");
+  ASSERT_ERROR(dropRelation (&space, "dept"), "an open relation cannot be dropped");
+  TEST_CHECK(closePageFile (&dept));
+  TEST_CHECK(closePageFile (&emp));
+
+  // enough relations that the directory spills over to more pages
+  for (i = 0; i < 200; i++)
+  {
+    sprintf(name, "rel_%d", i);
+    TEST_CHECK(createRelation (&space, name));
+  }
+  TEST_CHECK(closeTablespace (&space));
+
+  TEST_CHECK(openTablespace (TESTPF, &space));
+  TEST_CHECK(openRelation (&space, "rel_199", &dept));
+  TEST_CHECK(closePageFile (&dept));
+  TEST_CHECK(openRelation (&space, "emp", &emp));
+  ASSERT_EQUALS_INT(40, (int) emp.totalNumPages, "relation size survives reopening");
+  TEST_CHECK(readFirstBlock (&emp, ph));
+  for (i = 1, ok = strcmp(ph, "emp 0") == 0; i < 40; i++)
+  {
+    TEST_CHECK(readNextBlock (&emp, ph));
+    ok = ok && ph[PAGE_SIZE - 1] == 'e' && atoi(ph + 4) == i;
+  }
+  ASSERT_TRUE(ok, "a scan reads the relation's own pages in order");
+  TEST_CHECK(getTablespacePage (&emp, 39, &page));
+  ASSERT_TRUE((page > 0), "relation pages map into the tablespace file");
+
+  // growth through one handle reaches every other handle on the relation
+  TEST_CHECK(openRelation (&space, "emp", &view));
+  TEST_CHECK(appendEmptyBlock (&emp));
+  ASSERT_EQUALS_INT(41, (int) view.totalNumPages, "open handles follow the relation's size");
+
+  // freed pages go to the relation's own free list
+  TEST_CHECK(freePage (3, &emp));
+  TEST_CHECK(freePage (3, &view));
+  ASSERT_EQUALS_INT(1, (int) getNumFreePages(&view), "a page is freed once");
+  ASSERT_ERROR(freePage (41, &emp), "only existing pages can be freed");
+
+  TEST_CHECK(allocatePage (&emp, &got));
+  ASSERT_EQUALS_INT(3, (int) got, "a freed page is handed out first");
+  TEST_CHECK(readBlock (3, &view, ph));
+  ASSERT_TRUE((ph[0] == 0 && ph[PAGE_SIZE - 1] == 0), "a reused page reads back empty");
+  TEST_CHECK(allocatePage (&emp, &got));
+  ASSERT_EQUALS_INT(41, (int) got, "without free pages the relation grows");
+  ASSERT_EQUALS_INT(42, (int) view.totalNumPages, "allocating grows every handle");
+
+  // relation I/O shows up once, in the tablespace file's counters
+  TEST_CHECK(resetFileStats (&emp));
+  TEST_CHECK(writeBlock (5, &emp, ph));
+  TEST_CHECK(getFileStats (&view, &stats));
+  ASSERT_EQUALS_INT(1, (int) stats.numWriteCalls, "a relation write is one write call");
+  ASSERT_EQUALS_INT(1, (int) (stats.numSequential + stats.numRandom), "a relation write is one access");
+  TEST_CHECK(closePageFile (&view));
+
+  // dropped extents are reused, zeroed, before the file grows
+  TEST_CHECK(dropRelation (&space, "dept"));
+  ASSERT_ERROR(closeTablespace (&space), "a tablespace with open relations stays open");
+  TEST_CHECK(freePage (7, &emp));
+  TEST_CHECK(closePageFile (&emp));
+  TEST_CHECK(closeTablespace (&space));
+
+  TEST_CHECK(openTablespace (TESTPF, &space));
+  TEST_CHECK(openRelation (&space, "emp", &emp));
+  ASSERT_EQUALS_INT(42, (int) emp.totalNumPages, "growth inside an extent survives reopening");
+  ASSERT_EQUALS_INT(1, (int) getNumFreePages(&emp), "freed pages survive reopening");
+  TEST_CHECK(closePageFile (&emp));
+  TEST_CHECK(createRelation (&space, "tmp"));
+  TEST_CHECK(openRelation (&space, "tmp", &dept));
+  TEST_CHECK(ensureCapacity (30, &dept));
+  TEST_CHECK(readBlock (29, &dept, ph));
+  ASSERT_TRUE((ph[0] == 0 && ph[PAGE_SIZE - 1] == 0), "reused extent reads back empty");
+  TEST_CHECK(getTablespacePage (&dept, 0, &reused));
+  ASSERT_TRUE((reused < page), "the new relation starts in a dropped extent");
+  TEST_CHECK(closePageFile (&dept));
+  TEST_CHECK(closeTablespace (&space));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+
+  TEST_DONE();
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "wal_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTPF "test_walpages.bin"
+#define TESTLOG "test_walpages.log"
+
+#define COMMITTERS 8
+#define COMMITS_PER_THREAD 50
+
+/* prototypes for test functions */
+static void testReplay(void);
+static void testTornTail(void);
+static void testGroupCommit(void);
+static void testWriteAheadRule(void);
+
+/* main function running all tests */
+int
+main (void)
+{
+  testName = "";
+
+  initStorageManager();
+
+  testReplay();
+  testTornTail();
+  testGroupCommit();
+  testWriteAheadRule();
+
+  return 0;
+}
+
+/* Logged deltas are redone into a page file that never saw the writes */
+void
+testReplay(void)
+{
+  WAL_Log log;
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  LSN lsn, end;
+
+  testName = "test log replay";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  destroyLog(TESTLOG);
+  TEST_CHECK(openLog (TESTLOG, &log));
+
+  TEST_CHECK(logPageDelta (&log, 0, 10, 5, "hello", &lsn));
+  ASSERT_TRUE((getFlushedLSN(&log) < lsn), "an appended record is not durable yet");
+  memset(ph, 'x', PAGE_SIZE);
+  TEST_CHECK(logPageDelta (&log, 5, 100, 200, ph, &lsn));
+  TEST_CHECK(flushLog (&log, lsn));
+  ASSERT_TRUE((getFlushedLSN(&log) >= lsn), "flushLog makes the record durable");
+  end = getLogEnd(&log);
+  TEST_CHECK(closeLog (&log));
+
+  // redo into the page file, which grows to hold page 5
+  TEST_CHECK(openLog (TESTLOG, &log));
+  ASSERT_TRUE((getLogEnd(&log) == end), "log end survives reopening");
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(replayLog (&log, &fh));
+  ASSERT_EQUALS_INT(6, (int) fh.totalNumPages, "replay grows the page file");
+  TEST_CHECK(readBlock (0, &fh, ph));
+  ASSERT_TRUE((memcmp(ph + 10, "hello", 5) == 0 && ph[9] == 0 && ph[15] == 0), "delta lands at its offset");
+  TEST_CHECK(readBlock (5, &fh, ph));
+  ASSERT_TRUE((ph[100] == 'x' && ph[299] == 'x' && ph[300] == 0), "delta on a page past the old end");
+
+  // after a checkpoint nothing is replayed again, LSNs keep growing
+  TEST_CHECK(syncBlocks (0, fh.totalNumPages, &fh));
+  TEST_CHECK(truncateLog (&log));
+  ASSERT_TRUE((getLogEnd(&log) == end), "truncation keeps the LSN");
+  memset(ph, 'y', PAGE_SIZE);
+  TEST_CHECK(writeBlock (0, &fh, ph));
+  TEST_CHECK(closeLog (&log));
+  TEST_CHECK(openLog (TESTLOG, &log));
+  TEST_CHECK(replayLog (&log, &fh));
+  TEST_CHECK(readBlock (0, &fh, ph));
+  ASSERT_TRUE((ph[10] == 'y'), "truncated records are not replayed");
+  TEST_CHECK(logPageDelta (&log, 1, 0, 1, "z", &lsn));
+  ASSERT_TRUE((lsn > end), "LSNs keep growing after truncation");
+
+  TEST_CHECK(closeLog (&log));
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  TEST_CHECK(destroyLog (TESTLOG));
+  free(ph);
+
+  TEST_DONE();
+}
+
+/* A crash in the middle of an append leaves garbage the log must ignore */
+void
+testTornTail(void)
+{
+  WAL_Log log;
+  LSN end;
+  FILE *f;
+
+  testName = "test torn log tail";
+
+  destroyLog(TESTLOG);
+  TEST_CHECK(openLog (TESTLOG, &log));
+  TEST_CHECK(logPageDelta (&log, 3, 0, 4, "abcd", NULL));
+  TEST_CHECK(closeLog (&log));
+
+  TEST_CHECK(openLog (TESTLOG, &log));
+  end = getLogEnd(&log);
+  TEST_CHECK(closeLog (&log));
+
+  f = fopen(TESTLOG, "ab");
+  fputs("half a record", f);
+  fclose(f);
+
+  TEST_CHECK(openLog (TESTLOG, &log));
+  ASSERT_TRUE((getLogEnd(&log) == end), "torn tail is cut off");
+  TEST_CHECK(logPageDelta (&log, 3, 0, 4, "efgh", NULL));
+  TEST_CHECK(closeLog (&log));
+
+  TEST_CHECK(openLog (TESTLOG, &log));
+  ASSERT_TRUE((getLogEnd(&log) > end), "records appended after the cut are intact");
+  TEST_CHECK(closeLog (&log));
+  TEST_CHECK(destroyLog (TESTLOG));
+
+  f = fopen(TESTLOG, "w");
+  fputs("not a log", f);
+  fclose(f);
+  ASSERT_ERROR(openLog (TESTLOG, &log), "opening a file without log header should fail");
+  TEST_CHECK(destroyLog (TESTLOG));
+
+  TEST_DONE();
+}
+
+static void *
+committer(void *arg)
+{
+  WAL_Log *log = arg;
+  char delta[64];
+  LSN lsn;
+
+  memset(delta, 'c', sizeof(delta));
+  for (int i = 0; i < COMMITS_PER_THREAD; i++)
+  {
+    if (logPageDelta(log, i, 0, sizeof(delta), delta, &lsn) != RC_OK || flushLog(log, lsn) != RC_OK ||
+        getFlushedLSN(log) < lsn)
+      return (void *) 1;
+  }
+
+  return NULL;
+}
+
+/* Concurrent committers all become durable, sharing fdatasync calls */
+void
+testGroupCommit(void)
+{
+  WAL_Log log;
+  pthread_t threads[COMMITTERS];
+  void *failed;
+  int i, ok = 1;
+
+  testName = "test group commit";
+
+  destroyLog(TESTLOG);
+  TEST_CHECK(openLog (TESTLOG, &log));
+
+  for (i = 0; i < COMMITTERS; i++)
+    pthread_create(&threads[i], NULL, committer, &log);
+  for (i = 0; i < COMMITTERS; i++)
+  {
+    pthread_join(threads[i], &failed);
+    ok = ok && failed == NULL;
+  }
+
+  ASSERT_TRUE(ok, "every commit is durable when flushLog returns");
+  ASSERT_TRUE((getFlushedLSN(&log) == getLogEnd(&log)), "whole log is durable");
+  ASSERT_TRUE((getNumLogSyncs(&log) >= 1 && getNumLogSyncs(&log) <= COMMITTERS * COMMITS_PER_THREAD),
+      "at most one sync per commit");
+  printf("%lld syncs for %d commits\n", getNumLogSyncs(&log), COMMITTERS * COMMITS_PER_THREAD);
+
+  TEST_CHECK(closeLog (&log));
+  TEST_CHECK(destroyLog (TESTLOG));
+
+  TEST_DONE();
+}
+
+/* The buffer pool flushes the log before it writes a logged frame */
+void
+testWriteAheadRule(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  WAL_Log log;
+  LSN lsn;
+
+  testName = "test write-ahead rule in the buffer pool";
+
+  TEST_CHECK(createPageFile (TESTPF));
+  destroyLog(TESTLOG);
+  TEST_CHECK(openLog (TESTLOG, &log));
+  TEST_CHECK(initBufferPool (bm, TESTPF, 3, RS_CLOCK, NULL));
+  ASSERT_ERROR(logPageUpdate (bm, h, 0, 4, &lsn), "logging without a log set should fail");
+  TEST_CHECK(setPoolLog (bm, &log));
+
+  TEST_CHECK(pinPage (bm, h, 0));
+  memcpy(h->data + 8, "wal!", 4);
+  TEST_CHECK(logPageUpdate (bm, h, 8, 4, &lsn));
+  ASSERT_TRUE((getFlushedLSN(&log) < lsn), "logging alone does not sync");
+  TEST_CHECK(unpinPage (bm, h));
+
+  TEST_CHECK(forceFlushPool (bm));
+  ASSERT_TRUE((getFlushedLSN(&log) >= lsn), "log is durable before the page is written");
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "page written once");
+
+  TEST_CHECK(shutdownBufferPool (bm));
+  TEST_CHECK(closeLog (&log));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  TEST_CHECK(destroyLog (TESTLOG));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
@@ -0,0 +1,459 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "wal_mgr.h"
+
+// a log file is a small header followed by records back to back; the record
+// ending at file offset o has LSN base + (o - WAL_HEADER_SIZE)
+#define WAL_MAGIC "SMWALOG1"
+
+typedef struct WAL_FileHeader
+{
+    char magic[8];
+    LSN base; // LSN of the first byte after the header, moves up on truncateLog
+} WAL_FileHeader;
+
+#define WAL_HEADER_SIZE ((off_t)sizeof(WAL_FileHeader))
+
+#define WAL_PAGE_DELTA 1
+
+typedef struct WAL_Record
+{
+    unsigned int checksum; // over the rest of the record, a torn append fails it
+    int length; // bytes of after-image following the record
+    LSN lsn;
+    PageNumber pageNum;
+    int offset; // where the after-image goes in the page
+    int type;
+} WAL_Record;
+
+// records are gathered in memory and written by whichever committer leads the next flush
+#define WAL_MIN_BUFFER (64 * 1024)
+
+typedef struct WAL_Info
+{
+    int fd;
+    LSN base;
+    pthread_mutex_t lock;
+    pthread_cond_t flushDone;
+    char *buf; // appended records no flush has taken yet
+    size_t bufLen;
+    size_t bufCap;
+    char *spare; // the buffer a running flush writes from
+    size_t spareCap;
+    LSN appendedLSN; // end of the last appended record
+    LSN flushedLSN; // everything up to here is durable
+    int flushing; // a leader is writing and syncing, the others wait for it
+    int failed; // a write or sync failed, the log can no longer promise durability
+    long long numSyncs;
+} WAL_Info;
+
+static WAL_Info *getLogInfo(WAL_Log *log)
+{
+    return (log == NULL) ? NULL : (WAL_Info *)log->mgmtInfo;
+}
+
+static unsigned int recordChecksum(WAL_Record *rec, char *data)
+{
+    unsigned int hash = 2166136261u;
+    unsigned char *bytes = (unsigned char *)rec;
+
+    for (size_t i = sizeof(rec->checksum); i < sizeof(WAL_Record); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    for (int i = 0; i < rec->length; i++)
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+
+    return hash;
+}
+
+static RC writeFully(int fd, char *data, size_t length, off_t position)
+{
+    while (length > 0)
+    {
+        ssize_t done = pwrite(fd, data, length, position);
+
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return RC_WRITE_FAILED;
+
+        data += done;
+        length -= done;
+        position += done;
+    }
+
+    return RC_OK;
+}
+
+static RC applyRecord(SM_FileHandle *fHandle, WAL_Record *rec, char *data, char *page)
+{
+    if (rec->offset + rec->length > getPageSize(fHandle))
+        return RC_INVALID_LOG_FILE;
+
+    if (rec->pageNum >= fHandle->totalNumPages && ensureCapacity(rec->pageNum + 1, fHandle) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    if (readBlock(rec->pageNum, fHandle, page) != RC_OK)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    memcpy(page + rec->offset, data, rec->length);
+    return writeBlock(rec->pageNum, fHandle, page);
+}
+
+// walk the records in LSN order, redoing each into fHandle when one is given;
+// returns the file offset just past the last intact record
+static off_t scanLog(int fd, LSN base, SM_FileHandle *fHandle, RC *result)
+{
+    off_t position = WAL_HEADER_SIZE;
+    char *data = NULL;
+    int dataCap = 0;
+    char *page = (fHandle != NULL) ? malloc(getPageSize(fHandle)) : NULL;
+
+    *result = (fHandle != NULL && page == NULL) ? RC_MEMORY_ALLOCATION_FAILED : RC_OK;
+
+    while (*result == RC_OK)
+    {
+        WAL_Record rec;
+
+        if (pread(fd, &rec, sizeof(rec), position) != sizeof(rec))
+            break;
+
+        // records left over from before a truncateLog carry LSNs from the old base
+        off_t end = position + (off_t)sizeof(rec) + rec.length;
+        if (rec.type != WAL_PAGE_DELTA || rec.length <= 0 || rec.length > SM_MAX_PAGE_SIZE || rec.offset < 0 ||
+            rec.pageNum < 0 || rec.lsn != base + (end - WAL_HEADER_SIZE))
+            break;
+
+        if (rec.length > dataCap)
+        {
+            char *grown = realloc(data, rec.length);
+            if (grown == NULL)
+            {
+                *result = RC_MEMORY_ALLOCATION_FAILED;
+                break;
+            }
+            data = grown;
+            dataCap = rec.length;
+        }
+
+        if (pread(fd, data, rec.length, position + sizeof(rec)) != rec.length || recordChecksum(&rec, data) != rec.checksum)
+            break;
+
+        if (fHandle != NULL)
+            *result = applyRecord(fHandle, &rec, data, page);
+
+        if (*result == RC_OK)
+            position = end;
+    }
+
+    free(data);
+    free(page);
+    return position;
+}
+
+RC openLog(char *fileName, WAL_Log *log)
+{
+    WAL_FileHeader header;
+    struct stat st;
+    RC result = RC_OK;
+    int fd = open(fileName, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0)
+        return RC_FILE_NOT_FOUND;
+
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    if (st.st_size == 0)
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+
+        if (writeFully(fd, (char *)&header, sizeof(header), 0) != RC_OK || fdatasync(fd) != 0)
+            result = RC_WRITE_FAILED;
+    }
+    else if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0)
+    {
+        result = RC_INVALID_LOG_FILE;
+    }
+
+    WAL_Info *info = (result == RC_OK) ? calloc(1, sizeof(WAL_Info)) : NULL;
+    if (info == NULL)
+    {
+        close(fd);
+        return (result == RC_OK) ? RC_MEMORY_ALLOCATION_FAILED : result;
+    }
+
+    // a crash in the middle of an append leaves a torn record, the log ends before it
+    off_t end = scanLog(fd, header.base, NULL, &result);
+    if (end < st.st_size && ftruncate(fd, end) != 0)
+        result = RC_WRITE_FAILED;
+
+    if (result != RC_OK)
+    {
+        free(info);
+        close(fd);
+        return result;
+    }
+
+    info->fd = fd;
+    info->base = header.base;
+    info->appendedLSN = header.base + (end - WAL_HEADER_SIZE);
+    info->flushedLSN = info->appendedLSN;
+    pthread_mutex_init(&info->lock, NULL);
+    pthread_cond_init(&info->flushDone, NULL);
+
+    log->fileName = fileName;
+    log->mgmtInfo = info;
+    return RC_OK;
+}
+
+RC closeLog(WAL_Log *log)
+{
+    WAL_Info *info = getLogInfo(log);
+
+    if (info == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    RC result = flushLog(log, info->appendedLSN);
+
+    if (close(info->fd) != 0 && result == RC_OK)
+        result = RC_WRITE_FAILED;
+
+    pthread_mutex_destroy(&info->lock);
+    pthread_cond_destroy(&info->flushDone);
+    free(info->buf);
+    free(info->spare);
+    free(info);
+
+    log->fileName = NULL;
+    log->mgmtInfo = NULL;
+    return result;
+}
+
+RC destroyLog(char *fileName)
+{
+    return (unlink(fileName) == 0) ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+RC logPageDelta(WAL_Log *log, PageNumber pageNum, int offset, int length, char *data, LSN *lsn)
+{
+    WAL_Info *info = getLogInfo(log);
+
+    if (info == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (pageNum < 0 || offset < 0 || length <= 0 || data == NULL || offset + length > SM_MAX_PAGE_SIZE)
+        return RC_INVALID_ARGUMENT;
+
+    size_t size = sizeof(WAL_Record) + length;
+
+    pthread_mutex_lock(&info->lock);
+
+    if (info->bufLen + size > info->bufCap)
+    {
+        size_t cap = info->bufCap < WAL_MIN_BUFFER ? WAL_MIN_BUFFER : info->bufCap;
+        while (cap < info->bufLen + size)
+            cap *= 2;
+
+        char *grown = realloc(info->buf, cap);
+        if (grown == NULL)
+        {
+            pthread_mutex_unlock(&info->lock);
+            return RC_MEMORY_ALLOCATION_FAILED;
+        }
+
+        info->buf = grown;
+        info->bufCap = cap;
+    }
+
+    WAL_Record rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.length = length;
+    rec.lsn = info->appendedLSN + size;
+    rec.pageNum = pageNum;
+    rec.offset = offset;
+    rec.type = WAL_PAGE_DELTA;
+    rec.checksum = recordChecksum(&rec, data);
+
+    memcpy(info->buf + info->bufLen, &rec, sizeof(rec));
+    memcpy(info->buf + info->bufLen + sizeof(rec), data, length);
+    info->bufLen += size;
+    info->appendedLSN = rec.lsn;
+
+    pthread_mutex_unlock(&info->lock);
+
+    if (lsn != NULL)
+        *lsn = rec.lsn;
+
+    return RC_OK;
+}
+
+RC flushLog(WAL_Log *log, LSN lsn)
+{
+    WAL_Info *info = getLogInfo(log);
+    RC result = RC_OK;
+
+    if (info == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    pthread_mutex_lock(&info->lock);
+
+    if (lsn > info->appendedLSN)
+        lsn = info->appendedLSN;
+
+    while (info->flushedLSN < lsn)
+    {
+        if (info->failed)
+        {
+            result = RC_LOG_FAILED;
+            break;
+        }
+
+        if (info->flushing)
+        {
+            pthread_cond_wait(&info->flushDone, &info->lock);
+            continue;
+        }
+
+        // lead the flush: take every record appended so far, other committers' included,
+        // and let new appends go to the spare buffer meanwhile
+        char *out = info->buf;
+        size_t outLen = info->bufLen;
+        size_t outCap = info->bufCap;
+        LSN target = info->appendedLSN;
+        off_t position = WAL_HEADER_SIZE + (info->flushedLSN - info->base);
+
+        info->buf = info->spare;
+        info->bufCap = info->spareCap;
+        info->bufLen = 0;
+        info->spare = out;
+        info->spareCap = outCap;
+        info->flushing = 1;
+        pthread_mutex_unlock(&info->lock);
+
+        RC written = writeFully(info->fd, out, outLen, position);
+        if (written == RC_OK && fdatasync(info->fd) != 0)
+            written = RC_WRITE_FAILED;
+
+        pthread_mutex_lock(&info->lock);
+        info->flushing = 0;
+        if (written == RC_OK)
+        {
+            info->flushedLSN = target;
+            info->numSyncs++;
+        }
+        else
+        {
+            info->failed = 1;
+        }
+        pthread_cond_broadcast(&info->flushDone);
+    }
+
+    pthread_mutex_unlock(&info->lock);
+    return result;
+}
+
+LSN getFlushedLSN(WAL_Log *log)
+{
+    WAL_Info *info = getLogInfo(log);
+
+    if (info == NULL)
+        return 0;
+
+    pthread_mutex_lock(&info->lock);
+    LSN lsn = info->flushedLSN;
+    pthread_mutex_unlock(&info->lock);
+
+    return lsn;
+}
+
+LSN getLogEnd(WAL_Log *log)
+{
+    WAL_Info *info = getLogInfo(log);
+
+    if (info == NULL)
+        return 0;
+
+    pthread_mutex_lock(&info->lock);
+    LSN lsn = info->appendedLSN;
+    pthread_mutex_unlock(&info->lock);
+
+    return lsn;
+}
+
+long long getNumLogSyncs(WAL_Log *log)
+{
+    WAL_Info *info = getLogInfo(log);
+
+    if (info == NULL)
+        return 0;
+
+    pthread_mutex_lock(&info->lock);
+    long long syncs = info->numSyncs;
+    pthread_mutex_unlock(&info->lock);
+
+    return syncs;
+}
+
+RC replayLog(WAL_Log *log, SM_FileHandle *fHandle)
+{
+    WAL_Info *info = getLogInfo(log);
+    RC result;
+
+    if (info == NULL || fHandle == NULL || fHandle->mgmtInfo == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // only what reached the file can be replayed
+    if (flushLog(log, getLogEnd(log)) != RC_OK)
+        return RC_LOG_FAILED;
+
+    scanLog(info->fd, info->base, fHandle, &result);
+    return result;
+}
+
+RC truncateLog(WAL_Log *log)
+{
+    WAL_Info *info = getLogInfo(log);
+    WAL_FileHeader header;
+    RC result = RC_OK;
+
+    if (info == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    pthread_mutex_lock(&info->lock);
+    while (info->flushing)
+        pthread_cond_wait(&info->flushDone, &info->lock);
+
+    // the new base goes to disk first: a crash before the file is cut leaves old
+    // records whose LSNs no longer match, and scanLog stops at the first of them
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+    header.base = info->appendedLSN;
+
+    if (writeFully(info->fd, (char *)&header, sizeof(header), 0) != RC_OK || fdatasync(info->fd) != 0 ||
+        ftruncate(info->fd, WAL_HEADER_SIZE) != 0)
+        result = RC_WRITE_FAILED;
+
+    if (result == RC_OK)
+    {
+        info->base = header.base;
+        info->flushedLSN = header.base;
+        info->bufLen = 0;
+    }
+
+    pthread_mutex_unlock(&info->lock);
+    return result;
+}
@@ -0,0 +1,46 @@
+#ifndef WAL_MGR_H
+#define WAL_MGR_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+/************************************************************
+ *                    handle data structures                *
+ ************************************************************/
+/* log sequence number: the log position just past a record, so a page
+ * whose last change has LSN n is covered once the log is durable up to n */
+typedef long long LSN;
+
+typedef struct WAL_Log {
+	char *fileName;
+	void *mgmtInfo;
+} WAL_Log;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* opening a log creates it if needed; a torn record at the tail (crash
+ * in the middle of an append) is cut off */
+extern RC openLog (char *fileName, WAL_Log *log);
+extern RC closeLog (WAL_Log *log);
+extern RC destroyLog (char *fileName);
+
+/* append the after-image of bytes [offset, offset + length) of a page; the
+ * record is buffered and only durable once flushLog has covered its LSN */
+extern RC logPageDelta (WAL_Log *log, PageNumber pageNum, int offset, int length, char *data, LSN *lsn);
+
+/* group commit: wait until the log is durable up to lsn; callers arriving
+ * while a flush is running are all covered by the next single fdatasync */
+extern RC flushLog (WAL_Log *log, LSN lsn);
+extern LSN getFlushedLSN (WAL_Log *log);
+extern LSN getLogEnd (WAL_Log *log);
+extern long long getNumLogSyncs (WAL_Log *log);
+
+/* redo every record in the log into the page file, growing it where needed */
+extern RC replayLog (WAL_Log *log, SM_FileHandle *fHandle);
+
+/* drop all records once the pages they describe are durable in the page
+ * file; LSNs keep counting up from where they were */
+extern RC truncateLog (WAL_Log *log);
+
+#endif